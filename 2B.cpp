@@ -13,39 +13,1480 @@
 
 (4) Child Process:
     (a) Receives data from the parent via FIFO1
-    (b) Writes a copy to a temporary file 
+    (b) Writes a copy to a temporary file
     (c) Sends the same data back to the parent via FIFO2
+
+Transports (first argument , default copy):
+    copy   -> read()/write() through a 4KB user-space buffer on every hop
+    splice -> zero-copy , the data never enters user space:
+              parent: splice(source -> FIFO1)      splice(FIFO2 -> returned)
+              child : tee(FIFO1 -> FIFO2) duplicates the pipe contents ,
+                      splice(FIFO1 -> temp) then consumes them
+    shm    -> no FIFOs , one lock-free single-producer/single-consumer ring
+              per direction in POSIX shared memory (shm_open + mmap before
+              fork). The parent reads the file straight into the ring and
+              writes it straight out of the other one ; the child copies
+              ring -> ring with memcpy(). A side only enters the kernel
+              (futex) when its ring is empty or full.
+
+Full duplex (--duplex=threads|epoll , default threads , FIFO transports):
+    The child echoes every chunk as soon as it arrives , so if the parent only
+    started reading FIFO2 after sending everything , both pipes would fill up
+    and the two processes would block on each other. The parent therefore
+    sends and receives at the same time:
+    threads -> a sender thread writes FIFO1 while the main thread drains FIFO2
+    epoll   -> one thread , both FIFOs non-blocking , epoll_wait() only when
+               neither direction can make progress
+
+    All FIFO descriptors are non-blocking. Every EAGAIN is counted as one
+    "block" before waiting with poll()/epoll_wait(), so the report shows how
+    often each side stalled on an empty or full pipe. The shm transport
+    always uses a sender thread and counts futex sleeps instead.
+
+After the round trip the parent reports throughput (GB/s) and its own CPU
+time and the child's (getrusage) so the modes can be compared.
+
+File I/O (--io=sync|uring , default sync , copy transport only):
+    sync  -> blocking read()/write() on the files , in lockstep with the FIFOs
+    uring -> io_uring through raw syscalls (no liburing) with 8 registered
+             256KB buffers per ring: the parent's source reads run ahead of
+             the FIFO writes , and the returned/temp file writes stay in
+             flight while the next buffer is filled from the pipe. Requests
+             are submitted in batches. Falls back to sync if io_uring cannot
+             be set up. Each ring reports requests , the io_uring_enter()
+             calls that submitted them (batch size) , the wait-only calls
+             and average/max queue depth.
+
+Sharded mode (--shards=K1,K2,... , e.g. --shards=1,2,4,8):
+    The source is split into K byte ranges , each with its own child and
+    FIFO pair (fifo_parent_to_child_<i> , fifo_child_to_parent_<i>). The
+    parent pread()s every range out and pwrite()s it back into the returned
+    file at the same offset ; each child pwrite()s its range into the temp
+    copy. Copy transport , two parent threads per shard. Every K in the list
+    is run in turn and a table of time , aggregate GB/s , speedup and
+    efficiency relative to the first K is printed. Only the copy transport
+    with --duplex=threads and --io=sync is supported , other transport/io
+    options are rejected , as are list entries that are not a number > 0.
+
+Ping-pong latency (--pingpong[=N] , default N = 10000):
+    Messages of 8B , 16B , ... 64KB go parent -> child -> parent over the
+    FIFOs , N timed round trips per size after 100 warm-up ones. Each RTT is
+    recorded in a log-linear histogram (~3% resolution) and p50 / p99 /
+    p99.9 , min , max and mean are printed per size. --pin=P,C pins the
+    parent to CPU P and the child to CPU C so runs are reproducible. N must
+    be a number > 0 ; --pin and the transport/io options are rejected
+    outside of this mode , --shards inside it.
+
+Verification: instead of running diff on the files afterwards , the parent
+checksums what it sends and what it receives , and the child what it writes
+to the temp file , while the data streams (CRC32C per 1MB chunk , SSE4.2
+crc32 instruction when available). The child passes its checksums back over
+an anonymous pipe and the parent reports the first bad chunk offset on a
+mismatch. splice keeps the data out of user space , so in that transport
+the files are checksummed once after the transfer.
+
+Usage:   ./2B [copy|splice|shm] [--duplex=threads|epoll] [--io=sync|uring]
+         ./2B --shards=1,2,4,8
+         ./2B --pingpong=10000 --pin=0,1
+Compile: g++ -O2 -pthread 2B.cpp -o 2B
 */
 
 
 #include<iostream>
 #include<sys/types.h>      // System Types (pid_t , ssize_t)
 #include<sys/stat.h>       // File Attributes and permissions( "mkfifo() permissions" )
-#include<fcntl.h>          // File Open Flags
+#include<fcntl.h>          // File Open Flags , splice() , tee()
 
 #include<unistd.h>         // POSIX System Calls (fork(), read(), write(), close(), sleep())
 #include<cstring>          // C-Style string functions (strerror() , perror())
 #include<chrono>
-#include<cstdlib>          // exit() , system() 
+#include<cstdlib>          // exit()
+#include<string>
+#include<thread>           // sender thread in the parent
+#include<sys/wait.h>       // waitpid()
+#include<sys/resource.h>   // getrusage()
+#include<poll.h>           // poll()
+#include<sys/epoll.h>      // epoll_create1() , epoll_ctl() , epoll_wait()
+#include<sys/mman.h>       // shm_open() , mmap()
+#include<sys/syscall.h>    // syscall(SYS_futex)
+#include<linux/futex.h>    // FUTEX_WAIT , FUTEX_WAKE
+#include<atomic>
+#include<algorithm>
+#include<vector>
+#include<nmmintrin.h>      // _mm_crc32_u64() (SSE4.2)
+#include<linux/io_uring.h> // io_uring_params , io_uring_sqe , io_uring_cqe
+#include<sys/uio.h>        // struct iovec
+#include<sched.h>          // sched_setaffinity()
+#include<csignal>          // kill()
 
 using namespace std;
 
 #define FIFO1 "fifo_parent_to_child"
 #define FIFO2 "fifo_child_to_parent"
 #define BUFFER_SIZE 4096
+#define SPLICE_CHUNK (1 << 20)   // bytes asked for per splice()/tee() call
+#define PIPE_SIZE (1 << 20)      // FIFO capacity requested in splice mode
+#define SHM_NAME "/os_lab_2b_ring"
+#define RING_SIZE (1 << 22)      // bytes per direction in shm mode (power of two)
+#define RING_CHUNK (1 << 18)     // largest piece handed out by one reserve/peek
+#define RING_SPIN 1000           // empty/full checks before sleeping in futex()
+#define CHECK_CHUNK (1 << 20)    // stream bytes covered by one CRC32C
+#define PINGPONG_MIN 8           // smallest / largest ping-pong message (bytes)
+#define PINGPONG_MAX (1 << 16)
+#define PINGPONG_WARMUP 100      // round trips per size left out of the histogram
+#define LAT_SUB_BITS 5           // histogram buckets per power of two = 2^5
+#define URING_DEPTH 8            // registered buffers / requests in flight per ring
+#define URING_BLOCK (1 << 18)    // bytes per io_uring read or write
+#define URING_BATCH 4            // queued requests handed over per io_uring_enter()
+
+
+void set_nonblocking(int fd){
+    fcntl(fd , F_SETFL , fcntl(fd , F_GETFL) | O_NONBLOCK);
+}
+
+// Pipe was empty (POLLIN) or full (POLLOUT): count it and sleep until ready
+void wait_ready(int fd , short events , long long& blocked){
+    blocked++;
+    struct pollfd p = {fd , events , 0};
+    while(poll(&p , 1 , -1) < 0 && errno == EINTR){}
+}
+
+// write() may write less than asked , keep going until everything is out
+bool write_all(int fd , const char* buffer , ssize_t bytes , long long& blocked){
+    while(bytes > 0){
+        ssize_t n = write(fd , buffer , bytes);
+        if(n < 0){
+            if(errno == EAGAIN){
+                wait_ready(fd , POLLOUT , blocked);
+                continue;
+            }
+            perror("write");
+            return false;
+        }
+        buffer += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+bool pwrite_all(int fd , const char* buffer , ssize_t bytes , off_t offset){
+    while(bytes > 0){
+        ssize_t n = pwrite(fd , buffer , bytes , offset);
+        if(n < 0){
+            perror("pwrite");
+            return false;
+        }
+        buffer += n;
+        bytes -= n;
+        offset += n;
+    }
+    return true;
+}
+
+
+// ---------------- streaming CRC32C ----------------
+
+// Both sides checksum the stream while it passes through , one CRC32C per
+// CHECK_CHUNK bytes of stream offset , so a mismatch can be pinned down to
+// the first bad chunk without reading any file a second time.
+
+uint32_t crc_table[256];
+
+void init_crc_table(){
+    for(uint32_t i = 0 ; i < 256 ; i++){
+        uint32_t c = i;
+        for(int k = 0 ; k < 8 ; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : (c >> 1);
+        crc_table[i] = c;
+    }
+}
+
+uint32_t crc32c_table(uint32_t crc , const char* data , size_t len){
+    crc = ~crc;
+    for(size_t i = 0 ; i < len ; i++) crc = crc_table[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// SSE4.2 crc32 instruction , 8 bytes per step
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc , const char* data , size_t len){
+    uint64_t c = ~crc;
+    size_t i = 0;
+    for( ; i + 8 <= len ; i += 8){
+        uint64_t word;
+        memcpy(&word , data + i , 8);
+        c = _mm_crc32_u64(c , word);
+    }
+    for( ; i < len ; i++) c = _mm_crc32_u8((uint32_t)c , data[i]);
+    return ~(uint32_t)c;
+}
+
+uint32_t (*crc32c)(uint32_t , const char* , size_t) = crc32c_table;
+
+void select_crc32c(){
+    init_crc_table();
+    if(__builtin_cpu_supports("sse4.2")) crc32c = crc32c_hw;
+}
+
+struct StreamChecksum{
+    vector<uint32_t> chunks;   // CRC32C of every complete CHECK_CHUNK of the stream
+    uint32_t current = 0;      // CRC32C of the chunk being filled
+    uint64_t filled = 0;
+    uint64_t total = 0;
+
+    void update(const char* data , size_t len){
+        total += len;
+        while(len > 0){
+            size_t take = min<uint64_t>(len , CHECK_CHUNK - filled);
+            current = crc32c(current , data , take);
+            filled += take;
+            data += take;
+            len -= take;
+            if(filled == CHECK_CHUNK){
+                chunks.push_back(current);
+                current = 0;
+                filled = 0;
+            }
+        }
+    }
+
+    void finish(){
+        if(filled > 0) chunks.push_back(current);
+        current = 0;
+        filled = 0;
+    }
+
+    // One value for the whole stream: CRC32C over the chunk CRCs
+    uint32_t digest() const{
+        return crc32c(0 , (const char*)chunks.data() , chunks.size() * sizeof(uint32_t));
+    }
+};
+
+// splice() never brings the data into user space , so that transport has to
+// checksum the files after the transfer instead
+void checksum_file(const char* path , StreamChecksum& sum){
+    int fd = open(path , O_RDONLY);
+    if(fd < 0){
+        perror(path);
+        return;
+    }
+    vector<char> buffer(CHECK_CHUNK);
+    ssize_t n;
+    while((n = read(fd , buffer.data() , CHECK_CHUNK)) > 0) sum.update(buffer.data() , n);
+    close(fd);
+    sum.finish();
+}
+
+void report_check(const char* what , const StreamChecksum& expected , const StreamChecksum& got){
+    size_t common = min(expected.chunks.size() , got.chunks.size());
+    size_t bad = common;
+    for(size_t i = 0 ; i < common ; i++){
+        if(expected.chunks[i] != got.chunks[i]){
+            bad = i;
+            break;
+        }
+    }
+
+    if(bad == common && expected.total == got.total){
+        cout << what << ": OK (" << got.total << " bytes , crc32c digest 0x" << hex << got.digest() << dec << ")\n";
+        return;
+    }
+
+    cout << what << ": MISMATCH , first bad chunk " << bad << " at offset " << bad * (uint64_t)CHECK_CHUNK
+         << " (" << got.total << " of " << expected.total << " bytes)\n";
+}
+
+// The child hands its checksums of the temp copy to the parent over a pipe
+void send_checksums(int fd , const StreamChecksum& sum){
+    uint64_t header[2] = {sum.total , sum.chunks.size()};   // total bytes , chunk count
+    long long unused = 0;
+    write_all(fd , (const char*)header , sizeof(header) , unused);
+    write_all(fd , (const char*)sum.chunks.data() , sum.chunks.size() * sizeof(uint32_t) , unused);
+}
+
+// Reads exactly bytes bytes , false on EOF or error before that
+bool read_exact(int fd , char* buffer , size_t bytes){
+    while(bytes > 0){
+        ssize_t n = read(fd , buffer , bytes);
+        if(n <= 0){
+            if(n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        buffer += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+// False when the stream ends early (child died or failed to write its
+// report) , so that shows up as an I/O error instead of a checksum mismatch
+bool receive_checksums(int fd , StreamChecksum& sum){
+    uint64_t header[2];
+    if(!read_exact(fd , (char*)header , sizeof(header))) return false;
+
+    sum.total = header[0];
+    sum.chunks.resize(header[1]);
+    return read_exact(fd , (char*)sum.chunks.data() , header[1] * sizeof(uint32_t));
+}
+
+
+// ---------------- parent: one direction of the round trip ----------------
+
+// A pump moves data from one descriptor to the other (exactly one of them is
+// a FIFO) and never blocks: step() returns false when the FIFO is not ready.
+struct Pump{
+    int from , to;
+    int fifo;                 // the non-blocking end , what we wait on
+    short events;             // POLLIN when reading the FIFO , POLLOUT when writing it
+    bool use_splice;
+
+    char buffer[BUFFER_SIZE];
+    ssize_t pending = 0 , offset = 0;
+
+    bool done = false;
+    bool failed = false;             // a read or write failed , the stream is incomplete ;
+                                     // after a failed write the input is still drained
+                                     // (and dropped) so the other side never stalls
+    long long bytes = 0;
+    long long blocked = 0;
+    StreamChecksum* sum = nullptr;   // fed with everything written (copy only)
+
+    // Sharded mode: pread() a byte range of the source / pwrite() into the returned file
+    long long read_pos = -1 , read_left = 0;
+    long long write_pos = -1;
+
+    bool step(){
+        if(use_splice){
+            ssize_t n = splice(from , nullptr , to , nullptr , SPLICE_CHUNK , SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+            if(n < 0){
+                if(errno == EAGAIN){
+                    blocked++;
+                    return false;
+                }
+                perror("splice");
+                done = failed = true;
+                return false;
+            }
+            if(n == 0) done = true;   // EOF
+            bytes += n;
+            return true;
+        }
+
+        if(pending == 0){
+            ssize_t n;
+            if(read_pos >= 0){
+                n = pread(from , buffer , min<long long>(BUFFER_SIZE , read_left) , read_pos);
+                if(n > 0){
+                    read_pos += n;
+                    read_left -= n;
+                }
+            }
+            else n = read(from , buffer , BUFFER_SIZE);
+
+            if(n < 0){
+                if(errno == EAGAIN){
+                    blocked++;
+                    return false;
+                }
+                perror("read");
+                done = failed = true;
+                return false;
+            }
+            if(n == 0){
+                done = true;
+                return true;
+            }
+            pending = n;
+            offset = 0;
+            if(failed){
+                pending = 0;
+                return true;
+            }
+        }
+
+        ssize_t n;
+        if(write_pos >= 0){
+            n = pwrite(to , buffer + offset , pending , write_pos);
+            if(n > 0) write_pos += n;
+        }
+        else n = write(to , buffer + offset , pending);
+
+        if(n < 0){
+            if(errno == EAGAIN){
+                blocked++;
+                return false;
+            }
+            perror("write");
+            failed = true;
+            pending = 0;
+            return true;
+        }
+        // Only what reached the other side is checksummed
+        sum->update(buffer + offset , n);
+        offset += n;
+        pending -= n;
+        bytes += n;
+        return true;
+    }
+
+    // Blocking-style loop for the threads mode
+    void run(){
+        while(!done){
+            if(!step() && !done){
+                struct pollfd p = {fifo , events , 0};
+                while(poll(&p , 1 , -1) < 0 && errno == EINTR){}
+            }
+        }
+    }
+};
+
+void duplex_threads(Pump& send , Pump& receive){
+    thread sender([&]{
+        send.run();
+        close(send.to);     // EOF for the child
+    });
+    receive.run();
+    sender.join();
+}
+
+// Single thread: step whichever direction is ready , sleep in epoll_wait()
+// only when both are stalled on their FIFO
+void duplex_epoll(Pump& send , Pump& receive){
+    int ep = epoll_create1(0);
+    if(ep < 0){
+        perror("epoll_create1");
+        return;
+    }
+
+    Pump* pumps[2] = {&send , &receive};
+    bool ready[2] = {true , true};
+
+    for(int i = 0 ; i < 2 ; i++){
+        struct epoll_event ev = {};
+        ev.events = (pumps[i]->events == POLLOUT) ? EPOLLOUT : EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(ep , EPOLL_CTL_ADD , pumps[i]->fifo , &ev);
+    }
+
+    while(!send.done || !receive.done){
+        bool progressed = false;
+
+        for(int i = 0 ; i < 2 ; i++){
+            Pump* p = pumps[i];
+            if(p->done || !ready[i]) continue;
+
+            if(p->step()) progressed = true;
+            else ready[i] = false;
+
+            if(p->done){
+                epoll_ctl(ep , EPOLL_CTL_DEL , p->fifo , nullptr);
+                if(p == &send) close(send.to);   // EOF for the child
+            }
+        }
+
+        if(progressed) continue;
+
+        struct epoll_event events[2];
+        int n = epoll_wait(ep , events , 2 , -1);
+        for(int i = 0 ; i < n ; i++) ready[events[i].data.u32] = true;
+    }
+
+    close(ep);
+}
+
+
+// ---------------- child: echo FIFO1 -> temp + FIFO2 ----------------
+
+// Read from parent, write to temp and FIFO2 , false if any of it failed
+// temp_pos >= 0: pwrite() into the temp file from there on (sharded mode)
+bool child_copy(int fd_read , int fd_write , int temp , StreamChecksum& sum , long long& read_blocked , long long& write_blocked ,
+                long long temp_pos = -1){
+    char buffer[BUFFER_SIZE];
+    long long no_wait = 0;   // the temp file is a regular file and never returns EAGAIN
+    bool temp_ok = true;     // after a failed temp write the stream is still echoed
+
+    while(true){
+        ssize_t bytes = read(fd_read , buffer , BUFFER_SIZE);
+        if(bytes < 0){
+            if(errno == EAGAIN){
+                wait_ready(fd_read , POLLIN , read_blocked);
+                continue;
+            }
+            perror("read");
+            return false;
+        }
+        if(bytes == 0) return temp_ok;
+
+        // The checksum describes the temp copy , so it only covers written bytes
+        if(temp_ok){
+            if(temp_pos >= 0){
+                temp_ok = pwrite_all(temp , buffer , bytes , temp_pos);
+                temp_pos += bytes;
+            }
+            else temp_ok = write_all(temp , buffer , bytes , no_wait);
+            if(temp_ok) sum.update(buffer , bytes);
+        }
+
+        if(!write_all(fd_write , buffer , bytes , write_blocked)) return false;
+    }
+}
+
+// tee() copies pipe buffers from FIFO1 into FIFO2 without consuming them ,
+// then exactly that many bytes are spliced from FIFO1 into the temp file ;
+// false if either step failed
+bool child_splice(int fd_read , int fd_write , int temp , long long& read_blocked , long long& write_blocked){
+    while(true){
+        ssize_t n = tee(fd_read , fd_write , SPLICE_CHUNK , SPLICE_F_NONBLOCK);
+        if(n < 0){
+            if(errno == EAGAIN){
+                // Either FIFO1 is empty or FIFO2 is full , find out which
+                struct pollfd p = {fd_read , POLLIN , 0};
+                poll(&p , 1 , 0);
+                if(!(p.revents & (POLLIN | POLLHUP))) wait_ready(fd_read , POLLIN , read_blocked);
+                else wait_ready(fd_write , POLLOUT , write_blocked);
+                continue;
+            }
+            perror("tee");
+            return false;
+        }
+        if(n == 0) return true;   // EOF on FIFO1
+
+        while(n > 0){
+            ssize_t moved = splice(fd_read , nullptr , temp , nullptr , n , SPLICE_F_MOVE);
+            if(moved <= 0){
+                perror("splice");
+                return false;
+            }
+            n -= moved;
+        }
+    }
+}
+
+// ---------------- io_uring file I/O (copy transport) ----------------
+
+// Raw io_uring (no liburing): a small submission/completion ring with
+// URING_DEPTH registered buffers of URING_BLOCK bytes. File reads and writes
+// go through READ_FIXED / WRITE_FIXED so several of them are in flight while
+// the FIFO side keeps moving. Queued SQEs are handed to the kernel in batches
+// of URING_BATCH (or when we have to wait) , one io_uring_enter() per batch.
+
+int sys_io_uring_setup(unsigned entries , struct io_uring_params* p){
+    return syscall(__NR_io_uring_setup , entries , p);
+}
+
+int sys_io_uring_enter(int fd , unsigned submit , unsigned wait , unsigned flags){
+    return syscall(__NR_io_uring_enter , fd , submit , wait , flags , nullptr , 0);
+}
+
+int sys_io_uring_register(int fd , unsigned opcode , void* arg , unsigned count){
+    return syscall(__NR_io_uring_register , fd , opcode , arg , count);
+}
+
+struct Uring{
+    int fd = -1;
+    unsigned *sq_tail , *sq_mask , *sq_array;
+    unsigned *cq_head , *cq_tail , *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+
+    // Ring mappings , kept so release() can unmap them (cq == sq with a single mmap)
+    char *sq = nullptr , *cq = nullptr;
+    void* sqe_mem = nullptr;
+    size_t sq_size = 0 , cq_size = 0 , sqe_size = 0;
+
+    vector<char*> buffers;
+    unsigned queued = 0;      // filled in , not yet handed to the kernel
+    unsigned in_flight = 0;   // submitted , completion not reaped yet
+
+    long long submitted = 0 , submits = 0 , waits = 0 , depth_sum = 0;   // submits: enters that handed SQEs over , waits: wait-only enters
+    unsigned max_depth = 0;
+
+    bool init(unsigned depth){
+        struct io_uring_params p = {};
+        fd = sys_io_uring_setup(depth , &p);
+        if(fd < 0) return false;
+
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_size = cq_size = max(sq_size , cq_size);
+
+        sq = (char*)mmap(nullptr , sq_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_SQ_RING);
+        if(sq == MAP_FAILED){ sq = nullptr; release(); return false; }
+        cq = single ? sq : (char*)mmap(nullptr , cq_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_CQ_RING);
+        if(cq == MAP_FAILED){ cq = nullptr; release(); return false; }
+        sqe_mem = mmap(nullptr , sqe_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_SQES);
+        if(sqe_mem == MAP_FAILED){ sqe_mem = nullptr; release(); return false; }
+
+        sq_tail  = (unsigned*)(sq + p.sq_off.tail);
+        sq_mask  = (unsigned*)(sq + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq + p.sq_off.array);
+        cq_head  = (unsigned*)(cq + p.cq_off.head);
+        cq_tail  = (unsigned*)(cq + p.cq_off.tail);
+        cq_mask  = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes     = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        sqes     = (struct io_uring_sqe*)sqe_mem;
+
+        // Registered buffers are pinned once instead of on every request
+        vector<struct iovec> iov(depth);
+        buffers.resize(depth);
+        for(unsigned i = 0 ; i < depth ; i++){
+            buffers[i] = (char*)aligned_alloc(4096 , URING_BLOCK);
+            iov[i].iov_base = buffers[i];
+            iov[i].iov_len = URING_BLOCK;
+        }
+        if(sys_io_uring_register(fd , IORING_REGISTER_BUFFERS , iov.data() , depth) != 0){
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    // Unmaps the rings , closes the ring fd and frees the buffers , safe on a
+    // partly set up ring (every failed init() ends here)
+    void release(){
+        if(sqe_mem) munmap(sqe_mem , sqe_size);
+        if(cq && cq != sq) munmap(cq , cq_size);
+        if(sq) munmap(sq , sq_size);
+        sq = cq = nullptr;
+        sqe_mem = nullptr;
+
+        if(fd >= 0) close(fd);
+        fd = -1;
+
+        for(char* b : buffers) free(b);
+        buffers.clear();
+    }
+
+    ~Uring(){
+        release();
+    }
+
+    // user_data is the buffer index
+    void queue(unsigned char opcode , int file , unsigned buf , unsigned len , uint64_t offset){
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & *sq_mask;
+        struct io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe , 0 , sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = file;
+        sqe->addr = (uint64_t)buffers[buf];
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->buf_index = buf;
+        sqe->user_data = buf;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail , tail + 1 , __ATOMIC_RELEASE);
+        queued++;
+    }
+
+    // Hand all queued SQEs over in one io_uring_enter() , optionally waiting for a completion
+    void submit(unsigned wait){
+        int n = sys_io_uring_enter(fd , queued , wait , wait ? IORING_ENTER_GETEVENTS : 0);
+        if(n < 0){
+            if(errno != EINTR) perror("io_uring_enter");
+            return;
+        }
+        if(n > 0) submits++;
+        else waits++;
+        submitted += n;
+        queued -= n;
+        in_flight += n;
+        depth_sum += in_flight;
+        max_depth = max(max_depth , in_flight);
+    }
+
+    bool pop(struct io_uring_cqe& out){
+        unsigned head = *cq_head;
+        if(head == __atomic_load_n(cq_tail , __ATOMIC_ACQUIRE)) return false;
+        out = cqes[head & *cq_mask];
+        __atomic_store_n(cq_head , head + 1 , __ATOMIC_RELEASE);
+        in_flight--;
+        return true;
+    }
+
+    // Next completion , submitting and sleeping if none is ready yet
+    void wait_one(struct io_uring_cqe& out){
+        while(!pop(out)) submit(1);
+    }
+
+    void print_stats(const char* name){
+        long long enters = submits + waits;
+        cout << "io_uring " << name << ": " << submitted << " requests in " << submits << " submitting io_uring_enter calls ("
+             << (submits ? (double)submitted / submits : 0) << " per batch) + " << waits << " wait-only calls , queue depth avg "
+             << (enters ? (double)depth_sum / enters : 0) << " max " << max_depth << "\n";
+    }
+};
+
+// Source file -> FIFO: reads run up to URING_DEPTH blocks ahead of the FIFO writes
+long long uring_source(Uring& ring , int src , int fifo , StreamChecksum& sum , long long& blocked){
+    struct stat st;
+    fstat(src , &st);
+    uint64_t size = st.st_size;
+    uint64_t blocks = (size + URING_BLOCK - 1) / URING_BLOCK;
+
+    vector<bool> ready(URING_DEPTH , false);
+    vector<int> result(URING_DEPTH , 0);
+
+    uint64_t next_read = 0;
+    for( ; next_read < blocks && next_read < URING_DEPTH ; next_read++){
+        ring.queue(IORING_OP_READ_FIXED , src , next_read , URING_BLOCK , next_read * URING_BLOCK);
+    }
+
+    long long sent = 0;
+    for(uint64_t b = 0 ; b < blocks ; b++){
+        unsigned buf = b % URING_DEPTH;
+        while(!ready[buf]){
+            struct io_uring_cqe c;
+            ring.wait_one(c);
+            ready[c.user_data] = true;
+            result[c.user_data] = c.res;
+        }
+        ready[buf] = false;
+
+        if(result[buf] < 0){
+            cerr << "io_uring read: " << strerror(-result[buf]) << endl;
+            break;
+        }
+
+        // A short read is finished synchronously
+        uint64_t offset = b * URING_BLOCK;
+        uint64_t want = min<uint64_t>(URING_BLOCK , size - offset);
+        uint64_t len = result[buf];
+        while(len < want){
+            ssize_t n = pread(src , ring.buffers[buf] + len , want - len , offset + len);
+            if(n <= 0) break;
+            len += n;
+        }
+
+        sum.update(ring.buffers[buf] , len);
+        if(!write_all(fifo , ring.buffers[buf] , len , blocked)) break;
+        sent += len;
+
+        if(next_read < blocks){
+            ring.queue(IORING_OP_READ_FIXED , src , buf , URING_BLOCK , next_read * URING_BLOCK);
+            next_read++;
+        }
+        if(ring.queued >= URING_BATCH) ring.submit(0);
+    }
+
+    // Reap whatever is still outstanding (only after an error)
+    if(ring.queued > 0) ring.submit(0);
+    struct io_uring_cqe c;
+    while(ring.in_flight > 0) ring.wait_one(c);
+    return sent;
+}
+
+// FIFO -> file (and optionally echoed to a second FIFO): file writes stay in
+// flight while the next buffer is filled from the pipe. Returns the bytes
+// taken from the FIFO , or -1 if a read or write failed: the writes complete
+// out of order , so sum (in stream order) cannot wait for them and a failure
+// has to be reported this way.
+long long uring_sink(Uring& ring , int fifo , int file , int echo , StreamChecksum& sum ,
+                     long long& read_blocked , long long& write_blocked){
+    vector<unsigned> free_buffers;
+    for(unsigned i = 0 ; i < URING_DEPTH ; i++) free_buffers.push_back(i);
+    vector<uint64_t> lengths(URING_DEPTH) , offsets(URING_DEPTH);
+    bool failed = false;
+
+    auto complete = [&](struct io_uring_cqe& c){
+        unsigned buf = c.user_data;
+        if(c.res < 0){
+            cerr << "io_uring write: " << strerror(-c.res) << endl;
+            failed = true;
+        }
+        else{
+            // A short write is finished synchronously
+            for(uint64_t done = c.res ; done < lengths[buf] ; ){
+                ssize_t n = pwrite(file , ring.buffers[buf] + done , lengths[buf] - done , offsets[buf] + done);
+                if(n <= 0){
+                    perror("pwrite");
+                    failed = true;
+                    break;
+                }
+                done += n;
+            }
+        }
+        free_buffers.push_back(buf);
+    };
+
+    uint64_t offset = 0;
+    bool eof = false;
+    while(!eof){
+        struct io_uring_cqe c;
+        while(ring.pop(c)) complete(c);
+        if(free_buffers.empty()){
+            ring.wait_one(c);
+            complete(c);
+        }
+
+        unsigned buf = free_buffers.back();
+        free_buffers.pop_back();
+        char* data = ring.buffers[buf];
+
+        // Take what the pipe has , waiting only while the buffer is still empty
+        uint64_t len = 0;
+        while(len < URING_BLOCK){
+            ssize_t n = read(fifo , data + len , URING_BLOCK - len);
+            if(n > 0) len += n;
+            else if(n == 0){
+                eof = true;
+                break;
+            }
+            else if(errno == EAGAIN){
+                if(len > 0) break;
+                wait_ready(fifo , POLLIN , read_blocked);
+            }
+            else{
+                perror("read");
+                eof = failed = true;
+                break;
+            }
+        }
+
+        if(len == 0){
+            free_buffers.push_back(buf);
+            break;
+        }
+
+        sum.update(data , len);
+        if(echo >= 0 && !write_all(echo , data , len , write_blocked)) eof = failed = true;
+
+        lengths[buf] = len;
+        offsets[buf] = offset;
+        ring.queue(IORING_OP_WRITE_FIXED , file , buf , len , offset);
+        offset += len;
+
+        if(ring.queued >= URING_BATCH) ring.submit(0);
+    }
+
+    if(ring.queued > 0) ring.submit(0);
+    while(ring.in_flight > 0){
+        struct io_uring_cqe c;
+        ring.wait_one(c);
+        complete(c);
+    }
+    return failed ? -1 : (long long)offset;
+}
+
+
+// ---------------- shm transport: SPSC ring buffers ----------------
+
+// One single-producer / single-consumer byte ring per direction , living in a
+// POSIX shared memory object mapped before fork() so both processes see it.
+// head and tail sit on their own cache lines so the producer and consumer
+// never write to the same line. Each side spins briefly and only sleeps in
+// futex() when the ring is empty (consumer) or full (producer).
+struct Ring{
+    alignas(64) atomic<uint64_t> head;       // bytes published by the producer
+    alignas(64) atomic<uint64_t> tail;       // bytes consumed by the consumer
+    alignas(64) atomic<uint32_t> data_seq;   // futex word the consumer sleeps on
+    atomic<uint32_t> consumer_waiting;
+    atomic<uint32_t> closed;                 // producer is done , no more data
+    alignas(64) atomic<uint32_t> space_seq;  // futex word the producer sleeps on
+    atomic<uint32_t> producer_waiting;
+    alignas(64) char data[RING_SIZE];
+};
+
+// Fresh shm pages are zero-filled , which is an empty open ring
+struct ShmChannel{
+    Ring to_child;
+    Ring to_parent;
+};
+
+void futex_wait(atomic<uint32_t>* word , uint32_t expected){
+    syscall(SYS_futex , word , FUTEX_WAIT , expected , nullptr , nullptr , 0);
+}
+
+void futex_wake(atomic<uint32_t>* word){
+    syscall(SYS_futex , word , FUTEX_WAKE , 1 , nullptr , nullptr , 0);
+}
+
+// The sleeper announces itself in *waiting before re-checking ready() , the
+// waker publishes before checking *waiting (both seq_cst) , so a wake-up can
+// never be lost between the check and the futex() call.
+template<typename Ready>
+void ring_wait(atomic<uint32_t>& seq , atomic<uint32_t>& waiting , Ready ready , long long& blocked){
+    for(int spin = 0 ; spin < RING_SPIN ; spin++){
+        if(ready()) return;
+    }
+    while(!ready()){
+        uint32_t s = seq.load();
+        waiting.store(1);
+        if(!ready()){
+            blocked++;
+            futex_wait(&seq , s);
+        }
+        waiting.store(0);
+    }
+}
+
+void ring_wake(atomic<uint32_t>& seq , atomic<uint32_t>& waiting){
+    if(waiting.load()){
+        seq.fetch_add(1);
+        futex_wake(&seq);
+    }
+}
+
+// Producer: contiguous free space at head (at most RING_CHUNK bytes)
+char* ring_reserve(Ring& r , size_t& len , long long& blocked){
+    uint64_t head = r.head.load(memory_order_relaxed);
+    ring_wait(r.space_seq , r.producer_waiting , [&]{ return head - r.tail.load() < RING_SIZE; } , blocked);
+
+    uint64_t free_bytes = RING_SIZE - (head - r.tail.load(memory_order_acquire));
+    uint64_t to_end = RING_SIZE - head % RING_SIZE;
+    len = min<uint64_t>({free_bytes , to_end , RING_CHUNK});
+    return r.data + head % RING_SIZE;
+}
+
+void ring_publish(Ring& r , size_t n){
+    r.head.store(r.head.load(memory_order_relaxed) + n);
+    ring_wake(r.data_seq , r.consumer_waiting);
+}
 
-int main(){
-    // Create FIFOs
+void ring_close(Ring& r){
+    r.closed.store(1);
+    ring_wake(r.data_seq , r.consumer_waiting);
+}
 
-    // mkfifo() -> Creates a named pipe with read/write operations.
-    // 0666 -> Allows all users to read/write.
-    // errno != EXIST -> ignores "already exists" error.
+// Consumer: contiguous data at tail (at most RING_CHUNK bytes) , nullptr at EOF
+const char* ring_peek(Ring& r , size_t& len , long long& blocked){
+    uint64_t tail = r.tail.load(memory_order_relaxed);
+    ring_wait(r.data_seq , r.consumer_waiting , [&]{ return r.head.load() != tail || r.closed.load(); } , blocked);
 
-    if(mkfifo(FIFO1 , 0666) == -1 && errno != EEXIST){
-        perror("mkfifo FIFO1");
+    uint64_t available = r.head.load(memory_order_acquire) - tail;
+    if(available == 0) return nullptr;   // closed and drained
+
+    uint64_t to_end = RING_SIZE - tail % RING_SIZE;
+    len = min<uint64_t>({available , to_end , RING_CHUNK});
+    return r.data + tail % RING_SIZE;
+}
+
+void ring_release(Ring& r , size_t n){
+    r.tail.store(r.tail.load(memory_order_relaxed) + n);
+    ring_wake(r.space_seq , r.producer_waiting);
+}
+
+ShmChannel* create_channel(){
+    int fd = shm_open(SHM_NAME , O_CREAT | O_RDWR | O_TRUNC , 0666);
+    if(fd < 0){
+        perror("shm_open");
+        return nullptr;
+    }
+    if(ftruncate(fd , sizeof(ShmChannel)) < 0){
+        perror("ftruncate");
+        return nullptr;
+    }
+
+    void* mem = mmap(nullptr , sizeof(ShmChannel) , PROT_READ | PROT_WRITE , MAP_SHARED , fd , 0);
+    close(fd);
+    shm_unlink(SHM_NAME);   // the mapping survives , and is inherited by fork()
+    if(mem == MAP_FAILED){
+        perror("mmap");
+        return nullptr;
+    }
+    return static_cast<ShmChannel*>(mem);
+}
+
+// Parent: the file is read straight into the ring and written straight out of
+// it ; false if writing the returned file failed
+bool parent_shm(ShmChannel* ch , int src , int dest , StreamChecksum& sent_sum , StreamChecksum& received_sum ,
+                long long& send_blocked , long long& receive_blocked){
+    thread sender([&]{
+        while(true){
+            size_t len;
+            char* slot = ring_reserve(ch->to_child , len , send_blocked);
+            ssize_t n = read(src , slot , len);
+            if(n <= 0){
+                if(n < 0) perror("read");
+                break;
+            }
+            sent_sum.update(slot , n);
+            ring_publish(ch->to_child , n);
+        }
+        ring_close(ch->to_child);
+    });
+
+    long long no_wait = 0;
+    size_t len;
+    const char* data;
+    bool ok = true;     // after a failed write the ring is still drained so the child can finish
+    while((data = ring_peek(ch->to_parent , len , receive_blocked)) != nullptr){
+        if(ok){
+            ok = write_all(dest , data , len , no_wait);
+            if(ok) received_sum.update(data , len);
+        }
+        ring_release(ch->to_parent , len);
+    }
+
+    sender.join();
+    return ok;
+}
+
+// Child: ring -> temp file , ring -> ring ; false if the temp write failed
+bool child_shm(ShmChannel* ch , int temp , StreamChecksum& sum , long long& read_blocked , long long& write_blocked){
+    long long no_wait = 0;
+    size_t len;
+    const char* data;
+
+    bool ok = true;     // after a failed temp write the stream is still echoed
+    while((data = ring_peek(ch->to_child , len , read_blocked)) != nullptr){
+        if(ok){
+            ok = write_all(temp , data , len , no_wait);
+            if(ok) sum.update(data , len);
+        }
+
+        for(size_t done = 0 ; done < len ; ){
+            size_t space;
+            char* slot = ring_reserve(ch->to_parent , space , write_blocked);
+            space = min(space , len - done);
+            memcpy(slot , data + done , space);
+            ring_publish(ch->to_parent , space);
+            done += space;
+        }
+        ring_release(ch->to_child , len);
+    }
+    ring_close(ch->to_parent);
+    return ok;
+}
+
+
+// ---------------- sharded transfer ----------------
+
+// The source is split into K byte ranges (multiples of CHECK_CHUNK so the
+// per-shard checksums line up with the whole-file ones). Every range gets its
+// own child and FIFO pair ; the parent pread()s the range out and pwrite()s
+// it back into returned_1GB.bin , the child pwrite()s it into the temp copy.
+// Returns the round-trip time in seconds , or -1 on failure.
+double run_sharded(int K){
+    int src = open("source_1GB.bin" , O_RDONLY);
+    if(src < 0){
+        perror("Open Source File");
+        return -1;
+    }
+    struct stat st;
+    fstat(src , &st);
+    long long size = st.st_size;
+
+    int dest = open("returned_1GB.bin" , O_WRONLY | O_CREAT | O_TRUNC , 0666);
+    int temp = open("temp_child_copy.bin" , O_WRONLY | O_CREAT | O_TRUNC , 0666);
+    if(dest < 0 || temp < 0){
+        perror("Open Destination File");
+        return -1;
+    }
+    ftruncate(dest , size);
+    ftruncate(temp , size);
+    close(temp);
+
+    long long range = (size + K - 1) / K;
+    range = (range + CHECK_CHUNK - 1) / CHECK_CHUNK * CHECK_CHUNK;
+
+    vector<string> to_child(K) , to_parent(K);
+    for(int i = 0 ; i < K ; i++){
+        to_child[i] = string(FIFO1) + "_" + to_string(i);
+        to_parent[i] = string(FIFO2) + "_" + to_string(i);
+        if(mkfifo(to_child[i].c_str() , 0666) == -1 && errno != EEXIST) perror("mkfifo");
+        if(mkfifo(to_parent[i].c_str() , 0666) == -1 && errno != EEXIST) perror("mkfifo");
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    // Fork every child before the parent opens any FIFO , so no child
+    // inherits another shard's write end and misses its EOF
+    vector<int> reports(K);
+    vector<pid_t> pids;
+
+    // On a setup error the children already forked may sit in open() on
+    // their FIFOs forever , so they are killed and reaped before returning
+    auto fail = [&pids , &reports](const char* what){
+        perror(what);
+        for(size_t j = 0 ; j < pids.size() ; j++){
+            kill(pids[j] , SIGKILL);
+            waitpid(pids[j] , nullptr , 0);
+            close(reports[j]);
+        }
+        return -1.0;
+    };
+
+    for(int i = 0 ; i < K ; i++){
+        int report[2];
+        if(pipe(report) < 0) return fail("pipe");
+
+        pid_t pid = fork();
+        if(pid < 0) return fail("fork");
+
+        if(pid == 0){
+            close(report[0]);
+
+            int fd_read  = open(to_child[i].c_str() , O_RDONLY);
+            int fd_write = open(to_parent[i].c_str() , O_WRONLY);
+            int copy = open("temp_child_copy.bin" , O_WRONLY);
+            if(fd_read < 0 || fd_write < 0 || copy < 0){
+                perror("open shard");
+                _exit(1);
+            }
+            set_nonblocking(fd_read);
+            set_nonblocking(fd_write);
+
+            StreamChecksum sum;
+            long long read_blocked = 0 , write_blocked = 0;
+            bool ok = child_copy(fd_read , fd_write , copy , sum , read_blocked , write_blocked , i * range);
+
+            close(fd_read);
+            close(fd_write);
+            close(copy);
+            // No report on failure , the parent sees the missing report as an I/O error
+            if(!ok) _exit(1);
+            sum.finish();
+            send_checksums(report[1] , sum);
+            _exit(0);
+        }
+
+        pids.push_back(pid);
+        close(report[1]);
+        reports[i] = report[0];
+    }
+
+    vector<Pump> sends(K) , receives(K);
+    vector<StreamChecksum> sent_sums(K) , received_sums(K);
+    vector<int> fifo_in(K);
+
+    for(int i = 0 ; i < K ; i++){
+        int fd_write = open(to_child[i].c_str() , O_WRONLY);
+        int fd_read = open(to_parent[i].c_str() , O_RDONLY);
+        if(fd_write < 0 || fd_read < 0) return fail("Open FIFO");
+        set_nonblocking(fd_write);
+        set_nonblocking(fd_read);
+        fifo_in[i] = fd_read;
+
+        long long begin = min(size , i * range);
+        long long end = min(size , begin + range);
+
+        Pump& send = sends[i];
+        send.from = src;        send.to = fd_write;  send.fifo = fd_write;  send.events = POLLOUT;
+        send.use_splice = false;
+        send.sum = &sent_sums[i];
+        send.read_pos = begin;
+        send.read_left = end - begin;
+
+        Pump& receive = receives[i];
+        receive.from = fd_read; receive.to = dest;   receive.fifo = fd_read; receive.events = POLLIN;
+        receive.use_splice = false;
+        receive.sum = &received_sums[i];
+        receive.write_pos = begin;
+    }
+
+    // Two threads per shard: sender and receiver
+    vector<thread> workers;
+    for(int i = 0 ; i < K ; i++){
+        workers.emplace_back([&sends , &receives , i]{ duplex_threads(sends[i] , receives[i]); });
+    }
+    for(thread& t : workers) t.join();
+
+    auto end = chrono::high_resolution_clock::now();
+    chrono::duration<double> elapsed = end - start;
+
+    // Stitch the per-shard checksums back into whole-file ones
+    StreamChecksum sent_sum , received_sum , child_sum;
+    bool child_ok = true , receive_ok = true;
+    auto append = [](StreamChecksum& whole , const StreamChecksum& part){
+        whole.total += part.total;
+        whole.chunks.insert(whole.chunks.end() , part.chunks.begin() , part.chunks.end());
+    };
+    for(int i = 0 ; i < K ; i++){
+        close(fifo_in[i]);
+
+        StreamChecksum shard;
+        if(!receive_checksums(reports[i] , shard)) child_ok = false;
+        close(reports[i]);
+        waitpid(pids[i] , nullptr , 0);
+        if(receives[i].failed) receive_ok = false;
+
+        sent_sums[i].finish();
+        received_sums[i].finish();
+        append(sent_sum , sent_sums[i]);
+        append(received_sum , received_sums[i]);
+        append(child_sum , shard);
+    }
+
+    close(src);
+    close(dest);
+
+    cout << "K = " << K << ": " << elapsed.count() << " seconds\n";
+    if(child_ok) report_check("  Child temp copy" , sent_sum , child_sum);
+    else cout << "  Child temp copy: I/O error in the child , no complete checksum report\n";
+    if(receive_ok) report_check("  Returned file" , sent_sum , received_sum);
+    else cout << "  Returned file: I/O error writing returned_1GB.bin\n";
+    return elapsed.count();
+}
+
+
+// ---------------- ping-pong latency ----------------
+
+// Log-linear histogram (HdrHistogram style): values below 2^LAT_SUB_BITS get
+// their own bucket , above that every power of two is split into
+// 2^LAT_SUB_BITS buckets , so any recorded value is off by at most ~3%.
+struct LatencyHistogram{
+    vector<uint64_t> counts = vector<uint64_t>(65 << LAT_SUB_BITS , 0);
+    uint64_t samples = 0 , min_ns = ~0ULL , max_ns = 0;
+    double total_ns = 0;
+
+    static int index(uint64_t v){
+        if(v < (1ULL << LAT_SUB_BITS)) return v;
+        int shift = 63 - __builtin_clzll(v) - LAT_SUB_BITS;
+        return ((shift + 1) << LAT_SUB_BITS) + (int)((v >> shift) - (1ULL << LAT_SUB_BITS));
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t highest(int i){
+        int next = i + 1;
+        if(next < (1 << LAT_SUB_BITS)) return i;
+        int shift = (next >> LAT_SUB_BITS) - 1;
+        uint64_t sub = next & ((1 << LAT_SUB_BITS) - 1);
+        return (((1ULL << LAT_SUB_BITS) + sub) << shift) - 1;
+    }
+
+    void record(uint64_t ns){
+        counts[index(ns)]++;
+        samples++;
+        total_ns += ns;
+        min_ns = min(min_ns , ns);
+        max_ns = max(max_ns , ns);
+    }
+
+    uint64_t percentile(double p) const{
+        uint64_t rank = (uint64_t)(p / 100.0 * samples + 0.5);
+        if(rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for(size_t i = 0 ; i < counts.size() ; i++){
+            seen += counts[i];
+            if(seen >= rank) return min(highest(i) , max_ns);
+        }
+        return max_ns;
+    }
+};
+
+void pin_to_cpu(int cpu){
+    if(cpu < 0) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu , &set);
+    if(sched_setaffinity(0 , sizeof(set) , &set) != 0) perror("sched_setaffinity");
+}
+
+// Parent sends a message of each size through FIFO1 , the child sends it
+// straight back through FIFO2 , and the parent times every round trip.
+// Blocking FIFOs: each side sleeps in read() until the other one answers.
+int run_pingpong(int iterations , int parent_cpu , int child_cpu){
+    vector<size_t> sizes;
+    for(size_t size = PINGPONG_MIN ; size <= PINGPONG_MAX ; size *= 2) sizes.push_back(size);
+
+    if(mkfifo(FIFO1 , 0666) == -1 && errno != EEXIST) perror("mkfifo FIFO1");
+    if(mkfifo(FIFO2 , 0666) == -1 && errno != EEXIST) perror("mkfifo FIFO2");
+
+    vector<char> buffer(PINGPONG_MAX , 'x');
+    long long unused = 0;
+
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("fork");
+        return 1;
+    }
+
+    if(pid == 0){
+        pin_to_cpu(child_cpu);
+        int fd_read  = open(FIFO1 , O_RDONLY);
+        int fd_write = open(FIFO2 , O_WRONLY);
+        if(fd_read < 0 || fd_write < 0){
+            perror("open FIFO");
+            _exit(1);
+        }
+
+        // Same schedule as the parent: warm-up + measured iterations per size
+        for(size_t size : sizes){
+            for(int i = 0 ; i < PINGPONG_WARMUP + iterations ; i++){
+                if(!read_exact(fd_read , buffer.data() , size)) _exit(1);
+                if(!write_all(fd_write , buffer.data() , size , unused)) _exit(1);
+            }
+        }
+        close(fd_read);
+        close(fd_write);
+        _exit(0);
+    }
+
+    pin_to_cpu(parent_cpu);
+    int fd_write = open(FIFO1 , O_WRONLY);
+    int fd_read = open(FIFO2 , O_RDONLY);
+    if(fd_write < 0 || fd_read < 0){
+        perror("Open FIFO");
+        return 1;
+    }
+
+    cout << "Ping-pong over FIFOs: " << iterations << " round trips per size (+" << PINGPONG_WARMUP << " warm-up)";
+    if(parent_cpu >= 0) cout << " , parent on CPU " << parent_cpu << " , child on CPU " << child_cpu;
+    cout << "\n\nSize (B)  p50 (us)  p99 (us)  p99.9 (us)  min (us)  max (us)  mean (us)\n";
+
+    for(size_t size : sizes){
+        LatencyHistogram hist;
+        for(int i = 0 ; i < PINGPONG_WARMUP + iterations ; i++){
+            auto t0 = chrono::steady_clock::now();
+            if(!write_all(fd_write , buffer.data() , size , unused) || !read_exact(fd_read , buffer.data() , size)){
+                cerr << "ping-pong: child went away" << endl;
+                return 1;
+            }
+            auto t1 = chrono::steady_clock::now();
+            if(i >= PINGPONG_WARMUP) hist.record(chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+        }
+
+        cout << size << "  " << hist.percentile(50) / 1e3 << "  " << hist.percentile(99) / 1e3 << "  "
+             << hist.percentile(99.9) / 1e3 << "  " << hist.min_ns / 1e3 << "  " << hist.max_ns / 1e3 << "  "
+             << hist.total_ns / hist.samples / 1e3 << "\n";
     }
-    if(mkfifo(FIFO2 , 0666) == -1 && errno!= EEXIST){
-        perror("mkfifo FIFO2");
+
+    close(fd_write);
+    close(fd_read);
+    waitpid(pid , nullptr , 0);
+    return 0;
+}
+
+
+double cpu_seconds(const struct rusage& ru){
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+}
+
+
+int main(int argc , char* argv[]){
+    string transport = "copy";
+    string duplex = "threads";
+    string io = "sync";
+    vector<int> shards;
+    int pingpong = 0;               // iterations per message size , 0 = off
+    int parent_cpu = -1 , child_cpu = -1;
+    bool pin_given = false;
+
+    // Whole string must be a number > 0
+    auto positive = [](const string& text , int& value){
+        char* end = nullptr;
+        long v = strtol(text.c_str() , &end , 10);
+        if(text.empty() || *end != '\0' || v <= 0 || v > INT32_MAX) return false;
+        value = v;
+        return true;
+    };
+
+    for(int i = 1 ; i < argc ; i++){
+        string arg = argv[i];
+        if(arg.rfind("--duplex=" , 0) == 0) duplex = arg.substr(9);
+        else if(arg.rfind("--io=" , 0) == 0) io = arg.substr(5);
+        else if(arg.rfind("--shards=" , 0) == 0){
+            string list = arg.substr(9);
+            for(size_t pos = 0 ; pos <= list.size() ; ){
+                size_t comma = list.find(',' , pos);
+                if(comma == string::npos) comma = list.size();
+                int k;
+                if(!positive(list.substr(pos , comma - pos) , k)){
+                    cerr << "Invalid --shards list: " << list << " (expected K1,K2,... with every K > 0)" << endl;
+                    return 1;
+                }
+                shards.push_back(k);
+                pos = comma + 1;
+            }
+        }
+        else if(arg == "--pingpong") pingpong = 10000;
+        else if(arg.rfind("--pingpong=" , 0) == 0){
+            if(!positive(arg.substr(11) , pingpong)){
+                cerr << "Invalid --pingpong count: " << arg.substr(11) << " (expected N > 0)" << endl;
+                return 1;
+            }
+        }
+        else if(arg.rfind("--pin=" , 0) == 0){
+            if(sscanf(arg.c_str() + 6 , "%d,%d" , &parent_cpu , &child_cpu) != 2 || parent_cpu < 0 || child_cpu < 0){
+                cerr << "Invalid --pin: " << arg.substr(6) << " (expected P,C)" << endl;
+                return 1;
+            }
+            pin_given = true;
+        }
+        else transport = arg;
+    }
+
+    if((transport != "copy" && transport != "splice" && transport != "shm") || (duplex != "threads" && duplex != "epoll")
+       || (io != "sync" && io != "uring")){
+        cerr << "Usage: " << argv[0] << " [copy|splice|shm] [--duplex=threads|epoll] [--io=sync|uring] [--shards=1,2,4]"
+             << " [--pingpong[=N]] [--pin=P,C]" << endl;
+        return 1;
+    }
+
+    // Sharded and ping-pong runs always use copy over blocking/threaded FIFOs
+    // with sync file I/O , any other choice would be silently ignored
+    if((!shards.empty() || pingpong > 0) && (transport != "copy" || duplex != "threads" || io != "sync")){
+        cerr << (pingpong > 0 ? "--pingpong" : "--shards") << " only runs the copy transport with --duplex=threads and --io=sync" << endl;
+        return 1;
+    }
+    if(!shards.empty() && pingpong > 0){
+        cerr << "--shards and --pingpong are separate runs , pick one" << endl;
+        return 1;
+    }
+    if(pin_given && pingpong == 0){
+        cerr << "--pin=P,C only applies to --pingpong" << endl;
+        return 1;
+    }
+
+    bool use_splice = (transport == "splice");
+    bool use_shm = (transport == "shm");
+    bool use_uring = (io == "uring" && transport == "copy");
+
+    select_crc32c();
+
+    if(pingpong > 0) return run_pingpong(pingpong , parent_cpu , child_cpu);
+
+    // Sharded mode: one run per K , then the scaling table
+    if(!shards.empty()){
+        vector<double> seconds;
+        for(int k : shards){
+            double t = run_sharded(k);
+            if(t < 0) return 1;
+            seconds.push_back(t);
+        }
+
+        struct stat st;
+        stat("source_1GB.bin" , &st);
+
+        cout << "\nShards  Time (s)  GB/s  Speedup  Efficiency\n";
+        for(size_t i = 0 ; i < shards.size() ; i++){
+            double speedup = seconds[0] / seconds[i];
+            double efficiency = speedup * shards[0] / shards[i];
+            cout << shards[i] << "  " << seconds[i] << "  " << st.st_size / seconds[i] / 1e9 << "  "
+                 << speedup << "  " << efficiency << "\n";
+        }
+        return 0;
+    }
+
+    // The child sends its checksums of the temp copy back through this pipe
+    int report[2];
+    if(pipe(report) < 0){
+        perror("pipe");
+        return 1;
+    }
+
+    ShmChannel* channel = nullptr;
+
+    if(use_shm){
+        // Shared rings replace the FIFOs , set up before fork() so both sides map them
+        channel = create_channel();
+        if(channel == nullptr) return 1;
+    }
+    else{
+        // Create FIFOs
+
+        // mkfifo() -> Creates a named pipe with read/write operations.
+        // 0666 -> Allows all users to read/write.
+        // errno != EXIST -> ignores "already exists" error.
+
+        if(mkfifo(FIFO1 , 0666) == -1 && errno != EEXIST){
+            perror("mkfifo FIFO1");
+        }
+        if(mkfifo(FIFO2 , 0666) == -1 && errno!= EEXIST){
+            perror("mkfifo FIFO2");
+        }
     }
 
 
@@ -61,15 +1502,17 @@ int main(){
 
     if(pid >0){
         // Parent Process
-        cout << "Parent Process Started ....." << endl;
+        cout << "Parent Process Started (" << transport << " transport";
+        if(!use_shm) cout << " , " << duplex << " duplex";
+        cout << ") ....." << endl;
 
-        int fd_write = open(FIFO1 , O_WRONLY);
-        int fd_read = open(FIFO2 , O_RDONLY);
+        long long sent = 0 , received = 0 , send_blocked = 0 , receive_blocked = 0;
+        bool receive_ok = true;     // every byte that came back reached returned_1GB.bin
+        StreamChecksum sent_sum , received_sum;
+        close(report[1]);
 
-        if(fd_write < 0 || fd_read < 0){
-            perror("Open FIFO");
-            return 1;
-        }
+        Uring send_ring , receive_ring;
+        bool uring_ok = false;
 
         // Open the 1GB Source File
 
@@ -79,69 +1522,198 @@ int main(){
             return 1;
         }
 
-        // Send file to child 
-        char buffer[BUFFER_SIZE];
-        ssize_t bytes;
+        int dest = open("returned_1GB.bin" , O_WRONLY | O_CREAT | O_TRUNC , 0666);
+        if(dest < 0){
+            perror("Open Destination File");
+            return 1;
+        }
 
-        while((bytes = read(src,buffer,BUFFER_SIZE)) > 0){
-            write(fd_write , buffer , bytes);
+        if(use_shm){
+            receive_ok = parent_shm(channel , src , dest , sent_sum , received_sum , send_blocked , receive_blocked);
+            sent = sent_sum.total;
+            received = received_sum.total;
         }
-        close(src);
-        close(fd_write);
+        else{
+            // Open blocking (a non-blocking O_WRONLY open fails without a reader) , then switch
+            int fd_write = open(FIFO1 , O_WRONLY);
+            int fd_read = open(FIFO2 , O_RDONLY);
 
-        cout << "Parent -> Child Transfer Complete" << endl;
+            if(fd_write < 0 || fd_read < 0){
+                perror("Open FIFO");
+                return 1;
+            }
 
-        // Receive file back from Child 
-        int dest = open("returned_1GB.bin" , O_WRONLY | O_CREAT | O_TRUNC , 0666);
-        while((bytes = read(fd_read , buffer , BUFFER_SIZE)) > 0){
-            write(dest , buffer , bytes);
+            set_nonblocking(fd_write);
+            set_nonblocking(fd_read);
+
+            // Bigger pipes mean fewer splice() calls for the same data
+            if(use_splice){
+                fcntl(fd_write , F_SETPIPE_SZ , PIPE_SIZE);
+                fcntl(fd_read , F_SETPIPE_SZ , PIPE_SIZE);
+            }
+
+            // io_uring file I/O: sender thread + receiving main thread , each with its own ring
+            if(use_uring){
+                if(send_ring.init(URING_DEPTH) && receive_ring.init(URING_DEPTH)){
+                    thread sender([&]{
+                        sent = uring_source(send_ring , src , fd_write , sent_sum , send_blocked);
+                        close(fd_write);
+                    });
+                    long long unused = 0;
+                    received = uring_sink(receive_ring , fd_read , dest , -1 , received_sum , receive_blocked , unused);
+                    if(received < 0){
+                        receive_ok = false;
+                        received = received_sum.total;
+                    }
+                    sender.join();
+                    uring_ok = true;
+                }
+                else{
+                    perror("io_uring not available , falling back to read()/write()");
+                }
+            }
+
+            // Send file to child while receiving it back
+            Pump send , receive;
+            send.from = src;        send.to = fd_write;  send.fifo = fd_write;  send.events = POLLOUT;
+            receive.from = fd_read; receive.to = dest;   receive.fifo = fd_read; receive.events = POLLIN;
+            send.use_splice = receive.use_splice = use_splice;
+            send.sum = &sent_sum;
+            receive.sum = &received_sum;
+
+            if(!uring_ok){
+                if(duplex == "epoll") duplex_epoll(send , receive);
+                else duplex_threads(send , receive);
+
+                sent = send.bytes;
+                received = receive.bytes;
+                receive_ok = !receive.failed;
+                send_blocked = send.blocked;
+                receive_blocked = receive.blocked;
+            }
+
+            close(fd_read);
         }
+
+        close(src);
         close(dest);
-        close(fd_read);
 
 
-        
+
         auto end = chrono::high_resolution_clock::now();
         chrono::duration<double> elapsed = end - start;
         cout << "Child -> Parent transfer complete.\n";
         cout << "Total round-trip time: " << elapsed.count() << " seconds.\n";
+        cout << "Bytes sent: " << sent << " , received: " << received << "\n";
+        cout << "Throughput: " << received / elapsed.count() / 1e9 << " GB/s\n";
+        cout << "Parent blocked: send " << send_blocked << " times (parent -> child full) , receive "
+             << receive_blocked << " times (child -> parent empty)\n";
+        if(uring_ok){
+            send_ring.print_stats("source reads");
+            receive_ring.print_stats("returned writes");
+        }
+
+        // Drain the child's checksum report before waiting for it , a report
+        // larger than the pipe buffer would block the child in write() forever
+        StreamChecksum child_sum;
+        bool child_ok = receive_checksums(report[0] , child_sum);
+        close(report[0]);
+
+        // CPU time of both sides
+        waitpid(pid , nullptr , 0);
+
+        struct rusage self_usage , child_usage;
+        getrusage(RUSAGE_SELF , &self_usage);
+        getrusage(RUSAGE_CHILDREN , &child_usage);
 
-        // Compare files
-        cout << "\nComparing files using diff...\n";
-        system("diff source_1GB.bin returned_1GB.bin > compare_result.txt");
-        cout << "Comparison complete. Check compare_result.txt\n";
+        cout << "Parent CPU time: " << cpu_seconds(self_usage) << " seconds.\n";
+        cout << "Child CPU time: " << cpu_seconds(child_usage) << " seconds.\n";
+
+        // Compare checksums instead of the files
+        if(use_splice){
+            checksum_file("source_1GB.bin" , sent_sum);
+            checksum_file("returned_1GB.bin" , received_sum);
+        }
+        sent_sum.finish();
+        received_sum.finish();
+
+
+        cout << "\nVerifying CRC32C checksums (" << CHECK_CHUNK << " byte chunks" << (use_splice ? " , computed after the transfer" : "") << ")...\n";
+        if(child_ok) report_check("Child temp copy" , sent_sum , child_sum);
+        else cout << "Child temp copy: I/O error in the child , no complete checksum report\n";
+        if(receive_ok) report_check("Returned file" , sent_sum , received_sum);
+        else cout << "Returned file: I/O error writing returned_1GB.bin\n";
     }
 
     else{
-        //  CHILD PROCESS 
+        //  CHILD PROCESS
         cout << "Child process started...\n";
 
-        int fd_read  = open(FIFO1, O_RDONLY);
-        int fd_write = open(FIFO2, O_WRONLY);
-        if (fd_read < 0 || fd_write < 0) {
-            perror("open FIFO");
+        // Temporary file to save copy
+        int temp = open("temp_child_copy.bin", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (temp < 0) {
+            perror("open temp");
             exit(1);
         }
 
-        // Temporary file to save copy
-        int temp = open("temp_child_copy.bin", O_WRONLY | O_CREAT | O_TRUNC, 0666);
-        char buffer[BUFFER_SIZE];
-        ssize_t bytes;
+        long long read_blocked = 0 , write_blocked = 0;
+        StreamChecksum sum;
+        bool ok = true;
+        close(report[0]);
 
-        // Read from parent, write to temp and FIFO2
-        while ((bytes = read(fd_read, buffer, BUFFER_SIZE)) > 0) {
-            write(temp, buffer, bytes);
-            write(fd_write, buffer, bytes);
+        if (use_shm) {
+            ok = child_shm(channel, temp, sum, read_blocked, write_blocked);
+        }
+        else {
+            int fd_read  = open(FIFO1, O_RDONLY);
+            int fd_write = open(FIFO2, O_WRONLY);
+            if (fd_read < 0 || fd_write < 0) {
+                perror("open FIFO");
+                exit(1);
+            }
+
+            set_nonblocking(fd_read);
+            set_nonblocking(fd_write);
+
+            Uring ring;
+            bool uring_ok = false;
+            if (use_uring) {
+                if (ring.init(URING_DEPTH)) {
+                    ok = uring_sink(ring, fd_read, temp, fd_write, sum, read_blocked, write_blocked) >= 0;
+                    uring_ok = true;
+                }
+                else perror("child: io_uring not available , falling back to read()/write()");
+            }
+
+            if (uring_ok) ring.print_stats("temp writes");
+            else if (use_splice) ok = child_splice(fd_read, fd_write, temp, read_blocked, write_blocked);
+            else ok = child_copy(fd_read, fd_write, temp, sum, read_blocked, write_blocked);
+
+            close(fd_read);
+            close(fd_write);
         }
 
-        close(fd_read);
-        close(fd_write);
         close(temp);
+
+        // A failed copy sends no report , the parent prints it as an I/O error
+        if (!ok) {
+            cerr << "Child: copying into temp_child_copy.bin failed\n";
+            close(report[1]);
+            exit(1);
+        }
+        if (use_splice) checksum_file("temp_child_copy.bin", sum);
+        sum.finish();
+
+        // Hand the checksums of the temp copy to the parent
+        send_checksums(report[1], sum);
+        close(report[1]);
+
         cout << "Child process done transferring file.\n";
+        cout << "Child blocked: receive " << read_blocked << " times (parent -> child empty) , echo "
+             << write_blocked << " times (child -> parent full)\n";
         exit(0);
     }
 
     return 0;
     }
 
-
@@ -3,15 +3,108 @@
 // Once mapped, the file can be accessed like a normal array without explicit read() or write() system calls.
 //  The OS handles loading pages from disk into RAM as needed.
 
+// Random write / verify engine on an 8 GB mapped file
+//
+// Every thread owns a xorshift64* generator , so offsets cover the whole 64-bit
+// range of the file (rand() only gives 31 bits , i.e. the first 2 GB) and no
+// thread ever waits on a shared libc RNG.
+//
+// The byte written at an offset is a hash of (offset , run tag) , so the value
+// expected at any offset is known without remembering it , and two threads
+// hitting the same byte in overlap mode write the same value.
+//
+// Options:
+//   --threads=T          worker threads (default 1)
+//   --seconds=S          run time (default 10)
+//   --regions=disjoint   each thread gets FILE_SIZE / T bytes of its own (default)
+//   --regions=overlap    every thread works on the whole file
+//   --ratio=W:V          per batch: W writes , then V of them read back (default 1:1)
+//   --file-size=MB       size of the file (default 8192 = 8 GB)
+//   --seed=S             seed for the generators (default: time)
+//
+// Mapping modes:
+//   --advice=A[,A...]    madvise() hints on the whole mapping: random , sequential ,
+//                        willneed , hugepage (default none , i.e. kernel readahead)
+//   --populate           map with MAP_POPULATE (all pages faulted in by mmap())
+//   --prefault           before the timed run every thread reads one byte of each
+//                        page of its slice , so the run sees few read faults
+//
+// Minor/major page faults (getrusage) are reported for the setup and the run ,
+// next to the throughput , to pick the right mode per workload.
+//
+// Durability:
+//   --sync=none          never msync() , the kernel writes back whenever it likes (default)
+//   --sync=async         a background flusher wakes every --sync-interval ms , collects
+//                        the pages dirtied since the last pass from a bitmap , merges
+//                        them into a few ranges and issues msync(MS_ASYNC) per range
+//                        (Linux treats MS_ASYNC as a no-op , so each range is also
+//                        handed to sync_file_range() to actually start writeback)
+//   --sync=strict        same flusher , but msync(MS_SYNC): data is on disk when it returns
+//   --sync-interval=MS   flusher period (default 100)
+//
+// Latency:
+//   Writes and read-backs are timed with the TSC (rdtsc , calibrated against the
+//   steady clock at start-up) into one histogram per thread and operation type.
+//   --sample=N           time one operation in N (default 1 = every operation)
+//   --report-interval=S  every S seconds print ops/sec and p50/p99/p99.9/max of the
+//                        last interval over all threads (default 1 , 0 = off)
+//   At exit the same is printed per thread and in total , next to the flusher's
+//   msync() counts , so fault and writeback stalls show up in the tail.
+//
+// Workload:
+//   --pattern=P          sequential , strided , uniform (default) , zipf , hotset
+//   --access-size=B      bytes per access , 1 up to multi-page records (default 1)
+//   --stride=B           distance between strided accesses (default 4096 , at most
+//                        a thread's region)
+//   --zipf=THETA         Zipf skew , 0 < theta < 1 (default 0.99)
+//   --hot=F:P            hotset: P % of the accesses go to the first fraction F of
+//                        the region , 0 < F <= 1 , 0 <= P <= 100 (default 0.1:90)
+//   --read-pct=R         R % of the W accesses per batch are plain reads instead of
+//                        record writes (default 0) ; V read-backs still follow
+//   Records are written so that every byte holds the value of its own offset ,
+//   so a read-back checks the whole record.
+//
+// Backends (same workload , same seed , same offsets on each):
+//   --backend=B[,B...]   mmap (default) , pread (pread/pwrite through the page cache) ,
+//                        direct (O_DIRECT: records rounded up to 4 KB , aligned buffers
+//                        and offsets) , uring (io_uring: the W accesses of a batch in
+//                        one submission , then the V read-backs in another) , or all
+//   Each backend runs for --seconds in turn ; with more than one a table puts
+//   throughput , write/verify p50/p99/p99.9 and CPU time (user+sys) per op side by side.
+//   io_uring latency runs from queueing to reaping , so it includes the wait behind
+//   the rest of the batch. Mapping and --sync options only apply to mmap.
+//
+// Example: ./ass4 --threads=4 --seconds=10 --regions=overlap --ratio=8:1
+//          ./ass4 --threads=4 --advice=random --prefault
+//          ./ass4 --threads=4 --sync=async --sync-interval=50
+//          ./ass4 --threads=4 --pattern=zipf --access-size=512 --read-pct=70
+//          ./ass4 --threads=4 --backend=all --access-size=4096 --ratio=16:4
+// Compile: g++ -O2 -pthread ass4.cpp -o ass4
+
 
 #include <iostream>
-#include <fcntl.h>      // File Control Options
-#include <unistd.h>     // close() , ftruncate() , usleep() 
+#include <fcntl.h>      // File Control Options , sync_file_range()
+#include <unistd.h>     // close() , ftruncate() , usleep()
 #include <sys/mman.h>   // Memory mapping functions : mmap() , munmap()
-#include <cstdlib>      // rand() , srand() , exit()
+#include <cstdlib>      // atoi() , exit()
 #include <ctime>        // time() for seeding random numbeers
 #include <cstdint>      // Fixed-width integer types: uint8_t
 #include <cerrno>       // Error Handling
+#include <cstdio>       // perror() , sscanf()
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>        // pow() for the Zipf generator
+#include <sys/resource.h>   // getrusage() : page fault counts , CPU time
+#include <cstring>          // memset()
+#include <sys/syscall.h>    // syscall(__NR_io_uring_*)
+#include <sys/uio.h>        // struct iovec
+#include <linux/io_uring.h> // io_uring_params , io_uring_sqe , io_uring_cqe
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>      // __rdtsc()
+#endif
 
 
 using namespace std;
@@ -20,78 +113,1282 @@ using namespace std;
 #define FILE_SIZE  (8ULL * 1024 * 1024 * 1024)  // 8 GB
 
 
-int main(){
-    srand(time(nullptr));
-    // rand() using current time
+uint64_t file_size = FILE_SIZE;
+uint8_t* mapped;
+uint64_t run_tag;                 // mixed into every value , differs between runs
 
-    // Open or Create file
-    int fd = open(FILE_NAME , O_RDWR | O_CREAT , 0666);
+int num_threads = 1;
+bool overlap = false;
+int writes_per_batch = 1 , verifies_per_batch = 1;
 
-    if(fd < 0){
-        perror("open");
-        return 1;
+atomic<bool> stop_flag(false);
+
+long page_size;
+int page_shift;
+
+int file_fd;
+int sync_flags = 0;                 // 0 = no flusher , else MS_ASYNC or MS_SYNC
+int sync_interval_ms = 100;
+
+// One bit per page , set by the writers , cleared by the flusher
+atomic<uint64_t>* dirty_bits;
+uint64_t dirty_words;
+
+#define MERGE_GAP 64        // dirty pages at most this many pages apart share one msync()
+#define LAT_SUB_BITS 5      // latency histogram buckets per power of two = 2^5
+#define LAT_BUCKETS (65 << LAT_SUB_BITS)
+
+int sample_every = 1;
+double ns_per_tick = 1;
+
+// How the records get to the file
+//   mmap   -> loads and stores on the shared mapping
+//   pread  -> pread() / pwrite() through the page cache
+//   direct -> pread() / pwrite() on an O_DIRECT descriptor , page cache bypassed
+//   uring  -> io_uring , a batch of requests per io_uring_enter()
+enum BackendKind{ MMAP , PREAD , DIRECT , URING };
+const char* backend_names[] = {"mmap" , "pread" , "direct" , "uring"};
+
+BackendKind backend = MMAP;
+int io_fd;                          // file_fd , or the O_DIRECT descriptor
+
+#define DIRECT_ALIGN 4096   // O_DIRECT buffer , offset and length alignment
+#define URING_MAX_DEPTH 256
+
+// Run options shared by every backend
+double run_seconds = 10;
+double report_every = 1;
+string advice;
+bool populate = false , do_prefault = false;
+string sync_mode = "none";
+
+
+// SplitMix64: seeds the per-thread generators and hashes offsets into values
+uint64_t splitmix64(uint64_t x){
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// xorshift64*: a few cycles per number , full 64-bit output
+struct Xorshift64{
+    uint64_t state;
+
+    explicit Xorshift64(uint64_t seed) : state(splitmix64(seed) | 1) {}
+
+    uint64_t next(){
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
     }
 
-    // If file was smaller , it extends it(extra space filled wiht zeroes)
-    // If file wasd bigger , it truncates
+    // Uniform in [0 , range) without the bias of % (multiply-shift)
+    uint64_t below(uint64_t range){
+        return (uint64_t)(((unsigned __int128)next() * range) >> 64);
+    }
+};
 
-    if(ftruncate(fd , FILE_SIZE) == -1){
-        perror("ftruncate");
-        return 1;
+// One multiply per byte , cheap enough for multi-page records
+inline uint8_t expected_value(uint64_t offset){
+    return (uint8_t)(((offset ^ run_tag) * 0x9E3779B97F4A7C15ULL) >> 56);
+}
+
+
+struct FaultCount{
+    long minor , major;
+};
+
+// Whole process , all threads
+FaultCount faults_now(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF , &ru);
+    return {ru.ru_minflt , ru.ru_majflt};
+}
+
+// Page range of thread tid when the file is split in num_threads slices
+void thread_slice(int tid , uint64_t& begin , uint64_t& end){
+    uint64_t pages = (file_size + page_size - 1) / page_size;
+    begin = pages * tid / num_threads * page_size;
+    end = min(file_size , pages * (tid + 1) / num_threads * page_size);
+}
+
+// Touch one byte per page so the page tables are filled before the timed run
+void prefault(int tid){
+    uint64_t begin , end;
+    thread_slice(tid , begin , end);
+
+    volatile uint8_t sink = 0;
+    for(uint64_t off = begin ; off < end ; off += page_size) sink = sink + mapped[off];
+}
+
+
+// Log-linear histogram (HdrHistogram style): every power of two is split into
+// 2^LAT_SUB_BITS buckets , so a recorded value is off by at most ~3%
+struct LatencyHistogram{
+    vector<uint64_t> counts = vector<uint64_t>(LAT_BUCKETS , 0);
+    uint64_t samples = 0 , max_ns = 0;
+
+    static int index(uint64_t v){
+        if(v < (1ULL << LAT_SUB_BITS)) return v;
+        int shift = 63 - __builtin_clzll(v) - LAT_SUB_BITS;
+        return ((shift + 1) << LAT_SUB_BITS) + (int)((v >> shift) - (1ULL << LAT_SUB_BITS));
+    }
+
+    // Largest value that lands in bucket i
+    static uint64_t highest(int i){
+        int next = i + 1;
+        if(next < (1 << LAT_SUB_BITS)) return i;
+        int shift = (next >> LAT_SUB_BITS) - 1;
+        uint64_t sub = next & ((1 << LAT_SUB_BITS) - 1);
+        return (((1ULL << LAT_SUB_BITS) + sub) << shift) - 1;
+    }
+
+    void record(uint64_t ns){
+        counts[index(ns)]++;
+        samples++;
+        max_ns = max(max_ns , ns);
+    }
+
+    void merge(const LatencyHistogram& o){
+        for(size_t i = 0 ; i < counts.size() ; i++) counts[i] += o.counts[i];
+        samples += o.samples;
+        max_ns = max(max_ns , o.max_ns);
+    }
+
+    // What was recorded between snapshot "before" and this one (max is set by the caller)
+    LatencyHistogram since(const LatencyHistogram& before) const{
+        LatencyHistogram d;
+        for(size_t i = 0 ; i < counts.size() ; i++) d.counts[i] = counts[i] - before.counts[i];
+        d.samples = samples - before.samples;
+        return d;
+    }
+
+    uint64_t percentile(double p) const{
+        uint64_t rank = max<uint64_t>(1 , (uint64_t)(p / 100.0 * samples + 0.5));
+        uint64_t seen = 0;
+        for(size_t i = 0 ; i < counts.size() ; i++){
+            seen += counts[i];
+            if(seen >= rank) return min(highest(i) , max_ns);
+        }
+        return max_ns;
+    }
+};
+
+
+// The per-thread histogram the worker records into while the reporter reads it.
+// One writer per histogram , so a relaxed load + store replaces a locked
+// add on the hot path ; the reporter may see a count one op late , nothing more.
+struct LiveHistogram{
+    atomic<uint64_t> counts[LAT_BUCKETS];
+    atomic<uint64_t> samples , max_ns , interval_max_ns;
+
+    LiveHistogram(){
+        for(auto& c : counts) c.store(0 , memory_order_relaxed);
+        samples = 0;
+        max_ns = 0;
+        interval_max_ns = 0;
+    }
+
+    static void bump(atomic<uint64_t>& a , uint64_t n = 1){
+        a.store(a.load(memory_order_relaxed) + n , memory_order_relaxed);
+    }
+
+    void record(uint64_t ns){
+        bump(counts[LatencyHistogram::index(ns)]);
+        bump(samples);
+        if(ns > max_ns.load(memory_order_relaxed)) max_ns.store(ns , memory_order_relaxed);
+        if(ns > interval_max_ns.load(memory_order_relaxed)) interval_max_ns.store(ns , memory_order_relaxed);
+    }
+
+    // Cumulative counts so far
+    void snapshot(LatencyHistogram& out) const{
+        for(int i = 0 ; i < LAT_BUCKETS ; i++) out.counts[i] = counts[i].load(memory_order_relaxed);
+        out.samples = samples.load(memory_order_relaxed);
+        out.max_ns = max_ns.load(memory_order_relaxed);
+    }
+};
+
+struct alignas(64) ThreadStats{
+    atomic<uint64_t> writes{0};
+    atomic<uint64_t> verifies{0};
+    atomic<uint64_t> reads{0};
+    uint64_t mismatches = 0;
+    uint64_t read_sum = 0;        // keeps the plain reads from being optimised away
+    double seconds = 0;
+    LiveHistogram write_latency;
+    LiveHistogram verify_latency;
+    LiveHistogram read_latency;
+    uint64_t uring_requests = 0 , uring_enters = 0;
+};
+
+ThreadStats* stats;
+
+
+// Cheap timestamps: the TSC where there is one , the steady clock elsewhere
+inline uint64_t ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void calibrate_ticks(){
+    auto t0 = chrono::steady_clock::now();
+    uint64_t c0 = ticks();
+    this_thread::sleep_for(chrono::milliseconds(50));
+    uint64_t c1 = ticks();
+    double ns = chrono::duration<double , nano>(chrono::steady_clock::now() - t0).count();
+    ns_per_tick = ns / max<uint64_t>(1 , c1 - c0);
+}
+
+
+// ---------------- access patterns ----------------
+
+// The file (or the thread's slice of it) is seen as "slots" of access_size
+// bytes ; a pattern picks the next slot.
+//   sequential -> slot after slot , wrapping at the end
+//   strided    -> every (stride / access_size)-th slot , each lap shifted by one
+//   uniform    -> any slot with the same probability
+//   zipf       -> slot rank k with probability ~ 1/k^theta (YCSB / Gray et al.) ,
+//                 ranks scattered over the file by a hash so hot slots are not adjacent
+//   hotset     -> hot_pct % of the accesses go to the first hot_fraction of the slots
+enum PatternKind{ SEQUENTIAL , STRIDED , UNIFORM , ZIPF , HOTSET };
+
+PatternKind pattern_kind = UNIFORM;
+uint64_t access_size = 1;
+uint64_t stride_bytes = 4096;
+double zipf_theta = 0.99;
+double hot_fraction = 0.1;
+int hot_pct = 90;
+int read_pct = 0;
+
+#define NO_MISMATCH (~0ULL)
+
+// Sum of 1/i^theta for i = 1..n: exact for the first terms , integral for the tail
+double zeta(uint64_t n , double theta){
+    uint64_t exact = min<uint64_t>(n , 100000);
+    double sum = 0;
+    for(uint64_t i = 1 ; i <= exact ; i++) sum += 1.0 / pow((double)i , theta);
+    if(n > exact) sum += (pow((double)n , 1 - theta) - pow((double)exact , 1 - theta)) / (1 - theta);
+    return sum;
+}
+
+struct AccessPattern{
+    uint64_t begin , slots;
+    uint64_t cursor = 0 , lap = 0 , stride_slots = 1;
+    uint64_t hot_slots = 1;
+    double zetan = 0 , eta = 0 , alpha = 0 , half_pow = 0;
+
+    AccessPattern(uint64_t begin_ , uint64_t range , double start_fraction) : begin(begin_){
+        slots = max<uint64_t>(1 , range / access_size);
+        cursor = (uint64_t)(start_fraction * slots);
+        stride_slots = min(slots , max<uint64_t>(1 , stride_bytes / access_size));   // a stride past the region would never come back in range
+        if(pattern_kind == STRIDED) cursor -= cursor % stride_slots;
+        hot_slots = min(slots , max<uint64_t>(1 , (uint64_t)(hot_fraction * slots)));
+
+        if(pattern_kind == ZIPF){
+            zetan = zeta(slots , zipf_theta);
+            alpha = 1.0 / (1.0 - zipf_theta);
+            half_pow = pow(0.5 , zipf_theta);
+            eta = (1 - pow(2.0 / slots , 1 - zipf_theta)) / (1 - (1 + half_pow) / zetan);
+        }
+    }
+
+    uint64_t next(Xorshift64& rng){
+        uint64_t slot;
+        switch(pattern_kind){
+            case SEQUENTIAL:
+                slot = cursor;
+                if(++cursor == slots) cursor = 0;
+                break;
+
+            case STRIDED:
+                slot = cursor;
+                cursor += stride_slots;
+                if(cursor >= slots){
+                    lap = (lap + 1) % stride_slots;
+                    cursor = lap;
+                }
+                break;
+
+            case ZIPF:{
+                double u = (rng.next() >> 11) * 0x1.0p-53;
+                double uz = u * zetan;
+                uint64_t rank;
+                if(uz < 1) rank = 0;
+                else if(uz < 1 + half_pow) rank = 1;
+                else rank = min<uint64_t>(slots - 1 , (uint64_t)(slots * pow(eta * u - eta + 1 , alpha)));
+                slot = (uint64_t)(((unsigned __int128)splitmix64(rank) * slots) >> 64);
+                break;
+            }
+
+            case HOTSET:
+                if(hot_slots >= slots) slot = rng.below(slots);
+                else if((int)rng.below(100) < hot_pct) slot = rng.below(hot_slots);
+                else slot = hot_slots + rng.below(slots - hot_slots);
+                break;
+
+            default:
+                slot = rng.below(slots);
+        }
+        return begin + slot * access_size;
+    }
+};
+
+
+// Only the first writer of a page since the last flush pays for the atomic
+inline void mark_dirty(uint64_t offset){
+    uint64_t page = offset >> page_shift;
+    atomic<uint64_t>& word = dirty_bits[page >> 6];
+    uint64_t bit = 1ULL << (page & 63);
+    if(!(word.load(memory_order_relaxed) & bit)) word.fetch_or(bit , memory_order_relaxed);
+}
+
+struct FlushStats{
+    uint64_t passes = 0;
+    uint64_t msync_calls = 0;
+    uint64_t pages = 0;
+    double seconds = 0;          // time spent inside msync() / sync_file_range()
+    double max_call = 0;
+};
+
+FlushStats flush_stats;
+
+// Take every dirty bit , merge the pages into ranges , one msync() per range
+void flush_dirty(int flags){
+    FlushStats& fs = flush_stats;
+    fs.passes++;
+
+    uint64_t range_start = 0 , range_end = 0;    // pages , [start , end)
+    bool open_range = false;
+
+    auto sync_range = [&](){
+        uint64_t begin = range_start << page_shift;
+        uint64_t len = min(file_size , range_end << page_shift) - begin;
+        auto t0 = chrono::steady_clock::now();
+        if(msync(mapped + begin , len , flags) != 0) perror("msync");
+        if(flags == MS_ASYNC) sync_file_range(file_fd , begin , len , SYNC_FILE_RANGE_WRITE);
+        double t = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        fs.msync_calls++;
+        fs.seconds += t;
+        fs.max_call = max(fs.max_call , t);
+    };
+
+    for(uint64_t w = 0 ; w < dirty_words ; w++){
+        if(dirty_bits[w].load(memory_order_relaxed) == 0) continue;
+        uint64_t bits = dirty_bits[w].exchange(0 , memory_order_acq_rel);
+
+        while(bits){
+            uint64_t page = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            fs.pages++;
+
+            if(open_range && page <= range_end + MERGE_GAP){
+                range_end = page + 1;
+                continue;
+            }
+            if(open_range) sync_range();
+            range_start = page;
+            range_end = page + 1;
+            open_range = true;
+        }
+    }
+    if(open_range) sync_range();
+}
+
+void flusher(){
+    while(!stop_flag.load()){
+        this_thread::sleep_for(chrono::milliseconds(sync_interval_ms));
+        flush_dirty(sync_flags);
+    }
+}
+
+
+
+// Every byte of a record gets the value of its own offset
+inline void fill_record(uint8_t* rec , uint64_t F){
+    for(uint64_t i = 0 ; i < access_size ; i++) rec[i] = expected_value(F + i);
+}
+
+// Offset of the first wrong byte , or NO_MISMATCH
+inline uint64_t check_record(const uint8_t* rec , uint64_t F){
+    for(uint64_t i = 0 ; i < access_size ; i++){
+        if(rec[i] != expected_value(F + i)) return F + i;
+    }
+    return NO_MISMATCH;
+}
+
+inline uint64_t sum_record(const uint8_t* rec){
+    uint64_t sum = 0;
+    for(uint64_t i = 0 ; i < access_size ; i++) sum += rec[i];
+    return sum;
+}
+
+// A failed or short pread()/pwrite() ends the run , the data after it means nothing.
+// res < 0 is a failure with error code err , otherwise the bytes transferred.
+void io_error(const char* what , long res , int err){
+    if(res < 0) cerr << what << ": " << strerror(err) << endl;
+    else cerr << what << ": short transfer (" << res << " of " << access_size << " bytes)" << endl;
+    stop_flag = true;
+}
+
+// mmap: straight into the mapping ; pread and direct: through the thread's buffer
+inline void write_record(uint64_t F , uint8_t* buffer){
+    if(backend == MMAP){
+        fill_record(mapped + F , F);
+        if(sync_flags){
+            for(uint64_t page = F >> page_shift ; page <= (F + access_size - 1) >> page_shift ; page++) mark_dirty(page << page_shift);
+        }
+        return;
     }
+    fill_record(buffer , F);
+    ssize_t n = pwrite(io_fd , buffer , access_size , F);
+    if(n != (ssize_t)access_size) io_error("pwrite" , n , errno);
+}
+
+// Where the record can be looked at: the mapping , or the buffer it was read into ;
+// nullptr after a failed or short pread() , there is no record to look at then
+inline const uint8_t* load_record(uint64_t F , uint8_t* buffer){
+    if(backend == MMAP) return mapped + F;
+    ssize_t n = pread(io_fd , buffer , access_size , F);
+    if(n != (ssize_t)access_size){
+        io_error("pread" , n , errno);
+        return nullptr;
+    }
+    return buffer;
+}
+
+
+// The part of the file thread tid works on ; with O_DIRECT it has to start on a block
+void thread_region(int tid , uint64_t& begin , uint64_t& range){
+    begin = 0;
+    range = file_size;
+    if(!overlap){
+        range = file_size / num_threads;
+        begin = tid * range;
+        if(tid == num_threads - 1) range = file_size - begin;
+    }
+    if(backend == DIRECT){
+        uint64_t aligned = (begin + DIRECT_ALIGN - 1) & ~(uint64_t)(DIRECT_ALIGN - 1);
+        range -= aligned - begin;
+        begin = aligned;
+    }
+}
+
+void report_mismatch(ThreadStats& st , uint64_t bad , uint8_t got){
+    if(st.mismatches++ == 0){
+        cerr << "Verfication failed at offset 0x" << hex << bad << " value ( " << (int)expected_value(bad)
+             << " , read = " << (int)got << ")" << dec << endl;
+    }
+}
+
+
+// mmap , pread/pwrite and O_DIRECT: one access after the other
+void worker(int tid , uint64_t seed){
+    Xorshift64 rng(seed + tid);
+
+    uint64_t begin , range;
+    thread_region(tid , begin , range);
+
+    // In overlap mode the sequential/strided cursors start staggered
+    AccessPattern pattern(begin , range , overlap ? (double)tid / num_threads : 0);
+
+    // One record , aligned so O_DIRECT can use it as it is
+    uint8_t* buffer = nullptr;
+    if(backend != MMAP) buffer = (uint8_t*)aligned_alloc(DIRECT_ALIGN , (access_size + DIRECT_ALIGN - 1) & ~(uint64_t)(DIRECT_ALIGN - 1));
+
+    vector<uint64_t> written(writes_per_batch);
+    ThreadStats& st = stats[tid];
+    auto start = chrono::steady_clock::now();
+    // ops left until the next timed one , separate so a fixed write/verify
+    // pattern cannot make the sampling hit only one kind
+    int write_countdown = sample_every , verify_countdown = sample_every , read_countdown = sample_every;
+    uint64_t read_sum = 0;
+
+    while(!stop_flag.load(memory_order_relaxed)){
+        // W accesses , each a plain read with probability read_pct , else a record write
+        int writes = 0 , reads = 0;
+        for(int w = 0 ; w < writes_per_batch ; w++){
+            uint64_t F = pattern.next(rng);            // Offset of the record
+
+            if(read_pct > 0 && (int)rng.below(100) < read_pct){
+                if(--read_countdown == 0){
+                    read_countdown = sample_every;
+                    uint64_t t0 = ticks();
+                    const uint8_t* rec = load_record(F , buffer);
+                    if(rec) read_sum += sum_record(rec);
+                    st.read_latency.record((ticks() - t0) * ns_per_tick);
+                }
+                else if(const uint8_t* rec = load_record(F , buffer)) read_sum += sum_record(rec);
+                reads++;
+                continue;
+            }
+
+            if(--write_countdown == 0){
+                write_countdown = sample_every;
+                uint64_t t0 = ticks();
+                write_record(F , buffer);              // Writes the record at offset F
+                st.write_latency.record((ticks() - t0) * ns_per_tick);
+            }
+            else write_record(F , buffer);
+            written[writes++] = F;
+        }
+        LiveHistogram::bump(st.writes , writes);
+        LiveHistogram::bump(st.reads , reads);
+
+        // Read back V of the written records , spread over the batch
+        int verifies = min(verifies_per_batch , writes);
+        for(int v = 0 ; v < verifies ; v++){
+            uint64_t F = written[(uint64_t)v * writes / verifies];
+            const uint8_t* rec;
+            uint64_t bad;
+
+            if(--verify_countdown == 0){
+                verify_countdown = sample_every;
+                uint64_t t0 = ticks();
+                rec = load_record(F , buffer);
+                bad = rec ? check_record(rec , F) : NO_MISMATCH;
+                st.verify_latency.record((ticks() - t0) * ns_per_tick);
+            }
+            else{
+                rec = load_record(F , buffer);
+                bad = rec ? check_record(rec , F) : NO_MISMATCH;
+            }
+
+            if(bad != NO_MISMATCH) report_mismatch(st , bad , rec[bad - F]);
+        }
+        LiveHistogram::bump(st.verifies , verifies);
+    }
+
+    st.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    st.read_sum = read_sum;
+    free(buffer);
+}
+
+
+// ---------------- io_uring ----------------
+
+// No liburing: the three system calls and the ring layout from <linux/io_uring.h>
+int sys_io_uring_setup(unsigned entries , struct io_uring_params* p){
+    return syscall(__NR_io_uring_setup , entries , p);
+}
+
+int sys_io_uring_enter(int fd , unsigned submit , unsigned wait , unsigned flags){
+    return syscall(__NR_io_uring_enter , fd , submit , wait , flags , nullptr , 0);
+}
+
+int sys_io_uring_register(int fd , unsigned opcode , void* arg , unsigned count){
+    return syscall(__NR_io_uring_register , fd , opcode , arg , count);
+}
+
+// One ring per thread ; every request of a batch has its own record-sized slot
+// in one buffer , registered with the kernel once so it is not pinned per request
+struct Uring{
+    int fd = -1;
+    unsigned entries = 0;
+    unsigned *sq_tail , *sq_mask , *sq_array;
+    unsigned *cq_head , *cq_tail , *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+
+    // Ring mappings , kept so release() can unmap them (cq_ring == sq_ring with a single mmap)
+    char *sq_ring = nullptr , *cq_ring = nullptr;
+    void* sqe_mem = nullptr;
+    size_t sq_size = 0 , cq_size = 0 , sqe_size = 0;
 
+    uint8_t* buffers = nullptr;
+    bool fixed = false;              // buffers registered -> READ_FIXED / WRITE_FIXED
+    vector<uint64_t> issued;         // ticks() when slot i was queued
 
+    unsigned queued = 0;             // filled in , not yet handed to the kernel
+    unsigned in_flight = 0;          // submitted , completion not reaped yet
+    uint64_t submitted = 0 , enters = 0;
 
-    // Memory Map to File
+    bool init(unsigned depth , unsigned slots){
+        struct io_uring_params p = {};
+        fd = sys_io_uring_setup(depth , &p);
+        if(fd < 0) return false;
+        entries = p.sq_entries;
 
-    // nmap maps the file into memory as a sequence of bytes
-    // Each byte is 8 bits
-    // Using  , ( uint8_t* ) , let's you treat the mapped memory as an array of bytes
+        sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_size = cq_size = max(sq_size , cq_size);
 
+        sq_ring = (char*)mmap(nullptr , sq_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_SQ_RING);
+        if(sq_ring == MAP_FAILED){ sq_ring = nullptr; release(); return false; }
+        cq_ring = single ? sq_ring : (char*)mmap(nullptr , cq_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_CQ_RING);
+        if(cq_ring == MAP_FAILED){ cq_ring = nullptr; release(); return false; }
+        sqe_mem = mmap(nullptr , sqe_size , PROT_READ | PROT_WRITE , MAP_SHARED | MAP_POPULATE , fd , IORING_OFF_SQES);
+        if(sqe_mem == MAP_FAILED){ sqe_mem = nullptr; release(); return false; }
+
+        sq_tail  = (unsigned*)(sq_ring + p.sq_off.tail);
+        sq_mask  = (unsigned*)(sq_ring + p.sq_off.ring_mask);
+        sq_array = (unsigned*)(sq_ring + p.sq_off.array);
+        cq_head  = (unsigned*)(cq_ring + p.cq_off.head);
+        cq_tail  = (unsigned*)(cq_ring + p.cq_off.tail);
+        cq_mask  = (unsigned*)(cq_ring + p.cq_off.ring_mask);
+        cqes     = (struct io_uring_cqe*)(cq_ring + p.cq_off.cqes);
+        sqes     = (struct io_uring_sqe*)sqe_mem;
+
+        size_t bytes = ((uint64_t)slots * access_size + DIRECT_ALIGN - 1) & ~(uint64_t)(DIRECT_ALIGN - 1);
+        buffers = (uint8_t*)aligned_alloc(DIRECT_ALIGN , bytes);
+        if(!buffers){
+            release();
+            errno = ENOMEM;
+            return false;
+        }
+        issued.resize(slots);
+
+        // Not fatal: without registration the plain READ / WRITE opcodes are used
+        struct iovec iov = {buffers , bytes};
+        fixed = sys_io_uring_register(fd , IORING_REGISTER_BUFFERS , &iov , 1) == 0;
+        return true;
+    }
+
+    // Unmaps the rings , closes the ring fd and frees the buffers , safe on a
+    // partly set up ring (every failed init() ends here)
+    void release(){
+        if(sqe_mem) munmap(sqe_mem , sqe_size);
+        if(cq_ring && cq_ring != sq_ring) munmap(cq_ring , cq_size);
+        if(sq_ring) munmap(sq_ring , sq_size);
+        sq_ring = cq_ring = nullptr;
+        sqe_mem = nullptr;
+
+        if(fd >= 0) close(fd);
+        fd = -1;
+
+        free(buffers);
+        buffers = nullptr;
+    }
+
+    ~Uring(){
+        release();
+    }
+
+    uint8_t* slot(unsigned i){
+        return buffers + (uint64_t)i * access_size;
+    }
+
+    // user_data is the slot
+    void queue(bool read , unsigned i , uint64_t offset){
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & *sq_mask;
+        struct io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe , 0 , sizeof(*sqe));
+        if(fixed) sqe->opcode = read ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        else sqe->opcode = read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = io_fd;
+        sqe->addr = (uint64_t)slot(i);
+        sqe->len = access_size;
+        sqe->off = offset;
+        sqe->buf_index = 0;
+        sqe->user_data = i;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail , tail + 1 , __ATOMIC_RELEASE);
+        issued[i] = ticks();
+        queued++;
+    }
+
+    // Hand all queued SQEs over in one io_uring_enter() and wait for at least one completion
+    bool submit(){
+        int n = sys_io_uring_enter(fd , queued , 1 , IORING_ENTER_GETEVENTS);
+        if(n < 0){
+            if(errno == EINTR) return true;
+            perror("io_uring_enter");
+            return false;
+        }
+        enters++;
+        submitted += n;
+        queued -= n;
+        in_flight += n;
+        return true;
+    }
+
+    bool pop(struct io_uring_cqe& out){
+        unsigned head = *cq_head;
+        if(head == __atomic_load_n(cq_tail , __ATOMIC_ACQUIRE)) return false;
+        out = cqes[head & *cq_mask];
+        __atomic_store_n(cq_head , head + 1 , __ATOMIC_RELEASE);
+        in_flight--;
+        return true;
+    }
+
+    // Requests 0..n-1 , queued by prep(i) as many at a time as the ring holds ;
+    // done(i , res , ns) for each completion , ns counted from when i was queued
+    template<class Prep , class Done>
+    bool run_batch(unsigned n , Prep prep , Done done){
+        unsigned next = 0 , reaped = 0;
+        while(reaped < n){
+            while(next < n && queued + in_flight < entries) prep(next++);
+            if(!submit()) return false;
+
+            struct io_uring_cqe c;
+            while(pop(c)){
+                done((unsigned)c.user_data , c.res , (uint64_t)((ticks() - issued[c.user_data]) * ns_per_tick));
+                reaped++;
+            }
+        }
+        return true;
+    }
+};
+
+// io_uring: the W accesses of a batch go out together , then the V read-backs together
+void worker_uring(int tid , uint64_t seed){
+    Xorshift64 rng(seed + tid);
+
+    uint64_t begin , range;
+    thread_region(tid , begin , range);
+    AccessPattern pattern(begin , range , overlap ? (double)tid / num_threads : 0);
+
+    ThreadStats& st = stats[tid];
+    Uring ring;
+    if(!ring.init(min(writes_per_batch , URING_MAX_DEPTH) , writes_per_batch)){
+        perror("io_uring_setup");
+        stop_flag = true;
+        return;
+    }
+
+    vector<uint64_t> offsets(writes_per_batch) , written(writes_per_batch) , checked(writes_per_batch);
+    vector<char> is_read(writes_per_batch);
+    auto start = chrono::steady_clock::now();
+    int write_countdown = sample_every , verify_countdown = sample_every , read_countdown = sample_every;
+    uint64_t read_sum = 0;
+
+    while(!stop_flag.load(memory_order_relaxed)){
+        int writes = 0 , reads = 0;
+        for(int w = 0 ; w < writes_per_batch ; w++){
+            offsets[w] = pattern.next(rng);
+            is_read[w] = read_pct > 0 && (int)rng.below(100) < read_pct;
+            if(is_read[w]) continue;
+            fill_record(ring.slot(w) , offsets[w]);
+            written[writes++] = offsets[w];
+        }
+
+        bool ok = ring.run_batch(writes_per_batch ,
+            [&](unsigned i){ ring.queue(is_read[i] , i , offsets[i]); } ,
+            [&](unsigned i , int res , uint64_t ns){
+                if(res != (int)access_size) io_error(is_read[i] ? "io_uring read" : "io_uring write" , res , -res);
+                if(is_read[i]){
+                    read_sum += sum_record(ring.slot(i));
+                    if(--read_countdown == 0){
+                        read_countdown = sample_every;
+                        st.read_latency.record(ns);
+                    }
+                    reads++;
+                }
+                else if(--write_countdown == 0){
+                    write_countdown = sample_every;
+                    st.write_latency.record(ns);
+                }
+            });
+        if(!ok) break;
+        LiveHistogram::bump(st.writes , writes);
+        LiveHistogram::bump(st.reads , reads);
+
+        // Read back V of the written records , spread over the batch
+        int verifies = min(verifies_per_batch , writes);
+        for(int v = 0 ; v < verifies ; v++) checked[v] = written[(uint64_t)v * writes / verifies];
+
+        ok = ring.run_batch(verifies ,
+            [&](unsigned i){ ring.queue(true , i , checked[i]); } ,
+            [&](unsigned i , int res , uint64_t ns){
+                // A failed or short read-back is an I/O error , not a mismatch
+                if(res != (int)access_size) io_error("io_uring read" , res , -res);
+                else{
+                    uint64_t bad = check_record(ring.slot(i) , checked[i]);
+                    if(bad != NO_MISMATCH) report_mismatch(st , bad , ring.slot(i)[bad - checked[i]]);
+                }
+                if(--verify_countdown == 0){
+                    verify_countdown = sample_every;
+                    st.verify_latency.record(ns);
+                }
+            });
+        if(!ok) break;
+        LiveHistogram::bump(st.verifies , verifies);
+    }
+
+    st.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    st.read_sum = read_sum;
+    st.uring_requests = ring.submitted;
+    st.uring_enters = ring.enters;
+}
+
+
+
+void print_latency(const char* name , const LatencyHistogram& h){
+    cout << name << " p50/p99/p99.9/max " << h.percentile(50) / 1e3 << "/" << h.percentile(99) / 1e3 << "/"
+         << h.percentile(99.9) / 1e3 << "/" << h.max_ns / 1e3 << " us";
+}
+
+// Previous cumulative snapshots , so each report covers only its own interval
+struct IntervalState{
+    vector<LatencyHistogram> prev[3];     // write , verify , read per thread
+    vector<uint64_t> ops;
+    double last = 0;
+};
+
+const char* op_names[3] = {"write" , "verify" , "read"};
+
+LiveHistogram& live_histogram(ThreadStats& st , int kind){
+    return kind == 0 ? st.write_latency : kind == 1 ? st.verify_latency : st.read_latency;
+}
+
+uint64_t ops_done(ThreadStats& st){
+    return st.writes.load(memory_order_relaxed) + st.verifies.load(memory_order_relaxed) + st.reads.load(memory_order_relaxed);
+}
+
+// write | verify (| read when the mix has reads)
+void print_latencies(const LatencyHistogram* h){
+    for(int k = 0 ; k < (read_pct > 0 ? 3 : 2) ; k++){
+        cout << " | ";
+        print_latency(op_names[k] , h[k]);
+    }
+    cout << endl;
+}
+
+void report_interval(IntervalState& is , double now){
+    LatencyHistogram all[3];
+    uint64_t ops = 0;
+
+    for(int t = 0 ; t < num_threads ; t++){
+        ThreadStats& st = stats[t];
+        for(int k = 0 ; k < 3 ; k++){
+            LiveHistogram& live = live_histogram(st , k);
+            LatencyHistogram h;
+            live.snapshot(h);
+
+            LatencyHistogram d = h.since(is.prev[k][t]);
+            d.max_ns = live.interval_max_ns.exchange(0 , memory_order_relaxed);
+            all[k].merge(d);
+            is.prev[k][t] = h;
+        }
+
+        uint64_t done = ops_done(st);
+        ops += done - is.ops[t];
+        is.ops[t] = done;
+    }
+
+    cout << "[" << now << " s] " << ops / (now - is.last) / 1e6 << " M ops/sec";
+    print_latencies(all);
+    is.last = now;
+}
+
+
+// What one backend did , for the side-by-side table at the end
+struct BackendResult{
+    BackendKind kind;
+    double ops_per_sec = 0 , mb_per_sec = 0 , cpu_us_per_op = 0;
+    LatencyHistogram latency[3];
+    uint64_t mismatches = 0;
+};
+
+double cpu_seconds(){
+    struct rusage ru;
+    getrusage(RUSAGE_SELF , &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// Memory Map to File
+
+// nmap maps the file into memory as a sequence of bytes
+// Each byte is 8 bits
+// Using  , ( uint8_t* ) , let's you treat the mapped memory as an array of bytes
+
+// Map the file with the requested advice / populate / prefault
+bool map_file(){
+    int map_flags = MAP_SHARED | (populate ? MAP_POPULATE : 0);
+    mapped = (uint8_t*) mmap(nullptr , file_size , PROT_READ | PROT_WRITE , map_flags , file_fd , 0 );
 
-    uint8_t* mapped = (uint8_t*) mmap(nullptr , FILE_SIZE , PROT_READ | PROT_WRITE , MAP_SHARED , fd , 0 );
-    
     // returns void
 
     // nullptr -> Let OS choose the first address
-    // PROT_READ | PROT_WRITE  
+    // PROT_READ | PROT_WRITE
     // asking for memory permissions: (i) Read form it  , (ii) Write from it
-    
+
     // MAP_SHARED -> Updates we make in memory is written back to file
     // fd -> file descriptor of hte file you want to map (created / opened)
 
     //  offset from where mapping should be started
+    // MAP_POPULATE -> read the whole file in and fill the page tables right now
 
-    if(mapped == "MAP_FAILED"){
+    if(mapped == MAP_FAILED){
         perror("mmap");
-        return 1;
+        return false;
     }
 
-    cout << "File mapped successfully. Accessing memory now ... " << endl;
+    // madvise() -> tells the kernel how the mapping will be accessed
+    // RANDOM     -> no readahead around a fault
+    // SEQUENTIAL -> aggressive readahead , pages behind us can be dropped early
+    // WILLNEED   -> start reading the file in now
+    // HUGEPAGE   -> back the range with transparent huge pages where possible
+    for(size_t pos = 0 ; pos < advice.size() ; ){
+        size_t comma = advice.find(',' , pos);
+        if(comma == string::npos) comma = advice.size();
+        string a = advice.substr(pos , comma - pos);
+        pos = comma + 1;
 
+        int hint;
+        if(a == "random") hint = MADV_RANDOM;
+        else if(a == "sequential") hint = MADV_SEQUENTIAL;
+        else if(a == "willneed") hint = MADV_WILLNEED;
+        else if(a == "hugepage") hint = MADV_HUGEPAGE;
+        else{
+            cerr << "Unknown advice " << a << endl;
+            return false;
+        }
+        if(madvise(mapped , file_size , hint) != 0) perror(("madvise " + a).c_str());
+    }
 
-    while(true){
-        off_t F = rand() % FILE_SIZE;     // Offset: 0 to 8GB
-        uint8_t  X = rand() % 256;        // Value: 0 to 255
+    if(do_prefault){
+        vector<thread> threads;
+        for(int t = 0 ; t < num_threads ; t++) threads.emplace_back(prefault , t);
+        for(thread& t : threads) t.join();
+    }
+    return true;
+}
 
-        mapped[X] = F;
-        // Writes the byte X to offset F in the memory
-        
-        uint8_t X_read = mapped[F]; 
-        // Ensures Write Worker perfectly
+// The whole timed run on one backend , with its report
+bool run_backend(BackendKind kind , uint64_t seed , BackendResult& res){
+    backend = kind;
+    res.kind = kind;
 
+    // O_DIRECT moves whole blocks from and to aligned buffers at aligned offsets
+    uint64_t requested_size = access_size;
+    if(kind == DIRECT) access_size = (access_size + DIRECT_ALIGN - 1) & ~(uint64_t)(DIRECT_ALIGN - 1);
+    // The DIRECT region loses up to DIRECT_ALIGN to alignment , added on the
+    // access side so a region smaller than that cannot wrap the unsigned test
+    uint64_t region = file_size / num_threads;
+    if(region < access_size + (kind == DIRECT ? DIRECT_ALIGN : 0)){
+        cerr << "Access size larger than a thread's region" << endl;
+        access_size = requested_size;
+        return false;
+    }
 
-        if(X != X_read){
-            cerr << "Verfication failed at offset 0x" << hex << F << " value ( " <<(int)X << " , read = " << (int) X_read << ")" << endl;
-            
-            munmap(mapped , FILE_SIZE);
-            // un map file from memory
+    // msync() and the dirty bitmap only mean something for the mapping
+    int requested_sync = sync_flags;
+    if(kind != MMAP) sync_flags = 0;
 
-            close(fd);
+    auto setup_start = chrono::steady_clock::now();
+    FaultCount setup_faults = faults_now();
+
+    mapped = nullptr;
+    io_fd = file_fd;
+    bool ok = true;
+    if(kind == MMAP) ok = map_file();
+    else if(kind == DIRECT){
+        io_fd = open(FILE_NAME , O_RDWR | O_DIRECT);
+        if(io_fd < 0){
+            perror("open O_DIRECT");
+            ok = false;
+        }
+    }
+    else if(kind == URING){
+        // Fail here , before any thread starts , if the kernel has no io_uring
+        struct io_uring_params p = {};
+        int probe = sys_io_uring_setup(1 , &p);
+        if(probe < 0){
+            perror("io_uring_setup");
+            ok = false;
+        }
+        else close(probe);
+    }
+    if(!ok){
+        access_size = requested_size;
+        sync_flags = requested_sync;
+        return false;
+    }
+
+    FaultCount after_setup = faults_now();
+    double setup_seconds = chrono::duration<double>(chrono::steady_clock::now() - setup_start).count();
+
+    cout << "== Backend: " << backend_names[kind] << " ==" << endl;
+    if(kind == MMAP){
+        cout << "File mapped successfully. Accessing memory now ... " << endl;
+        cout << "Mapping: advice=" << (advice.empty() ? "none" : advice) << (populate ? " , MAP_POPULATE" : "")
+             << (do_prefault ? " , prefault" : "") << endl;
+    }
+    if(kind == DIRECT && access_size != requested_size){
+        cout << "O_DIRECT: records rounded up to " << access_size << " B , aligned to " << DIRECT_ALIGN << " B" << endl;
+    }
+    cout << "Setup: " << setup_seconds << " s , " << after_setup.minor - setup_faults.minor << " minor faults , "
+         << after_setup.major - setup_faults.major << " major faults" << endl;
+    const char* pattern_names[] = {"sequential" , "strided" , "uniform" , "zipf" , "hotset"};
+    cout << num_threads << " threads , " << (overlap ? "overlapping" : "disjoint") << " regions , "
+         << writes_per_batch << ":" << verifies_per_batch << " write:verify , " << run_seconds << " s" << endl;
+    cout << "Pattern: " << pattern_names[pattern_kind] << " , " << access_size << " B records , "
+         << read_pct << "% reads";
+    if(pattern_kind == STRIDED) cout << " , stride " << stride_bytes << " B";
+    if(pattern_kind == ZIPF) cout << " , theta " << zipf_theta;
+    if(pattern_kind == HOTSET) cout << " , " << hot_pct << "% of accesses on " << hot_fraction * 100 << "% of the file";
+    cout << endl;
+
+
+    stop_flag = false;
+    flush_stats = FlushStats();
+    for(uint64_t w = 0 ; w < dirty_words ; w++) dirty_bits[w].store(0 , memory_order_relaxed);
+
+    double cpu_start = cpu_seconds();
+    stats = new ThreadStats[num_threads];
+    vector<thread> threads;
+    for(int t = 0 ; t < num_threads ; t++){
+        if(kind == URING) threads.emplace_back(worker_uring , t , seed);
+        else threads.emplace_back(worker , t , seed);
+    }
+
+    thread flush_thread;
+    if(sync_flags) flush_thread = thread(flusher);
+
+    // Interval reports while the workers run
+    IntervalState is;
+    for(int k = 0 ; k < 3 ; k++) is.prev[k].resize(num_threads);
+    is.ops.assign(num_threads , 0);
+
+    auto run_start = chrono::steady_clock::now();
+    double next_report = (report_every > 0) ? report_every : run_seconds;
+    while(!stop_flag.load()){
+        double now = chrono::duration<double>(chrono::steady_clock::now() - run_start).count();
+        if(now >= run_seconds) break;
+
+        this_thread::sleep_for(chrono::duration<double>(min(next_report , run_seconds) - now));
+        now = chrono::duration<double>(chrono::steady_clock::now() - run_start).count();
+        if(report_every > 0 && now >= next_report){
+            report_interval(is , now);
+            next_report += report_every;
+        }
+    }
+    stop_flag = true;
+    for(thread& t : threads) t.join();
+
+    // Whatever was dirtied after the flusher's last pass
+    if(sync_flags){
+        flush_thread.join();
+        flush_dirty(sync_flags);
+    }
+
+    FaultCount after_run = faults_now();
+    double cpu_used = cpu_seconds() - cpu_start;
+
+
+    uint64_t total_writes = 0 , total_verifies = 0 , total_reads = 0 , total_mismatches = 0 , read_sum = 0;
+    uint64_t uring_requests = 0 , uring_enters = 0;
+    double total_rate = 0;
+    LatencyHistogram* all = res.latency;
+
+    for(int t = 0 ; t < num_threads ; t++){
+        ThreadStats& st = stats[t];
+        double rate = st.seconds > 0 ? ops_done(st) / st.seconds : 0;
+
+        LatencyHistogram h[3];
+        for(int k = 0 ; k < 3 ; k++){
+            live_histogram(st , k).snapshot(h[k]);
+            all[k].merge(h[k]);
+        }
+
+        cout << "Thread " << t << ": " << st.writes << " writes , " << st.verifies << " verifies , ";
+        if(read_pct > 0) cout << st.reads << " reads , ";
+        cout << rate / 1e6 << " M ops/sec";
+        print_latencies(h);
+
+        total_writes += st.writes;
+        total_verifies += st.verifies;
+        total_reads += st.reads;
+        total_mismatches += st.mismatches;
+        total_rate += rate;
+        read_sum += st.read_sum;
+        uring_requests += st.uring_requests;
+        uring_enters += st.uring_enters;
+    }
+    uint64_t total_ops = total_writes + total_verifies + total_reads;
+
+    res.ops_per_sec = total_rate;
+    res.mb_per_sec = total_rate * access_size / 1e6;
+    res.cpu_us_per_op = cpu_used * 1e6 / max<uint64_t>(1 , total_ops);
+    res.mismatches = total_mismatches;
+
+    cout << "Total: " << total_writes << " writes , " << total_verifies << " verifies , ";
+    if(read_pct > 0) cout << total_reads << " reads , ";
+    cout << total_rate / 1e6 << " M ops/sec , " << res.mb_per_sec << " MB/s";
+    print_latencies(all);
+    cout << "CPU: " << cpu_used << " s user+sys , " << res.cpu_us_per_op << " us per op" << endl;
+    cout << "Run faults: " << after_run.minor - after_setup.minor << " minor , " << after_run.major - after_setup.major
+         << " major (" << (double)(after_run.minor - after_setup.minor + after_run.major - after_setup.major) * 1000 / max<uint64_t>(1 , total_ops)
+         << " per 1000 ops)" << endl;
+    if(kind == URING){
+        cout << "io_uring: " << uring_requests << " requests in " << uring_enters << " io_uring_enter calls ("
+             << (uring_enters ? (double)uring_requests / uring_enters : 0) << " per call)" << endl;
+    }
+    cout << "Mismatches: " << total_mismatches << endl;
+    if(read_pct > 0) cout << "Read checksum: " << read_sum << endl;
+
+    if(kind == MMAP){
+        cout << "Durability: " << sync_mode;
+        if(sync_flags){
+            FlushStats& fs = flush_stats;
+            cout << " every " << sync_interval_ms << " ms: " << fs.passes << " passes , " << fs.msync_calls << " msync calls ("
+                 << (double)fs.msync_calls / fs.passes << " per pass) , " << fs.pages << " dirty pages , "
+                 << fs.seconds << " s flushing (longest call " << fs.max_call * 1e3 << " ms)";
+        }
+        cout << endl;
+
+        munmap(mapped , file_size);
+        // un map file from memory
+        mapped = nullptr;
+    }
+    if(kind == DIRECT) close(io_fd);
+    cout << endl;
+
+    delete[] stats;
+    access_size = requested_size;
+    sync_flags = requested_sync;
+    return true;
+}
+
+// One line per backend: throughput , write and verify percentiles , CPU per op
+void print_comparison(const vector<BackendResult>& results){
+    printf("%-8s %10s %10s  %-24s  %-24s %10s\n" , "backend" , "M ops/s" , "MB/s" ,
+           "write p50/p99/p99.9 us" , "verify p50/p99/p99.9 us" , "CPU us/op");
+    for(const BackendResult& r : results){
+        char lat[2][64];
+        for(int k = 0 ; k < 2 ; k++){
+            const LatencyHistogram& h = r.latency[k];
+            snprintf(lat[k] , sizeof(lat[k]) , "%.2f/%.2f/%.2f" , h.percentile(50) / 1e3 , h.percentile(99) / 1e3 , h.percentile(99.9) / 1e3);
+        }
+        printf("%-8s %10.3f %10.1f  %-24s  %-24s %10.3f%s\n" , backend_names[r.kind] , r.ops_per_sec / 1e6 , r.mb_per_sec ,
+               lat[0] , lat[1] , r.cpu_us_per_op , r.mismatches ? "  MISMATCHES" : "");
+    }
+}
+
+
+int main(int argc , char* argv[]){
+    uint64_t seed = time(nullptr);
+    string backend_list = "mmap";
+
+    for(int i = 1 ; i < argc ; i++){
+        string opt = argv[i];
+        if(opt.rfind("--threads=" , 0) == 0) num_threads = max(1 , atoi(opt.c_str() + 10));
+        else if(opt.rfind("--seconds=" , 0) == 0) run_seconds = atof(opt.c_str() + 10);
+        else if(opt == "--regions=overlap") overlap = true;
+        else if(opt == "--regions=disjoint") overlap = false;
+        else if(opt.rfind("--ratio=" , 0) == 0) sscanf(opt.c_str() + 8 , "%d:%d" , &writes_per_batch , &verifies_per_batch);
+        else if(opt.rfind("--file-size=" , 0) == 0) file_size = strtoull(opt.c_str() + 12 , nullptr , 10) << 20;
+        else if(opt.rfind("--seed=" , 0) == 0) seed = strtoull(opt.c_str() + 7 , nullptr , 10);
+        else if(opt.rfind("--advice=" , 0) == 0) advice = opt.substr(9);
+        else if(opt == "--populate") populate = true;
+        else if(opt == "--prefault") do_prefault = true;
+        else if(opt.rfind("--sync=" , 0) == 0) sync_mode = opt.substr(7);
+        else if(opt.rfind("--sync-interval=" , 0) == 0) sync_interval_ms = max(1 , atoi(opt.c_str() + 16));
+        else if(opt.rfind("--sample=" , 0) == 0) sample_every = max(1 , atoi(opt.c_str() + 9));
+        else if(opt.rfind("--report-interval=" , 0) == 0) report_every = atof(opt.c_str() + 18);
+        else if(opt.rfind("--pattern=" , 0) == 0){
+            string p = opt.substr(10);
+            if(p == "sequential") pattern_kind = SEQUENTIAL;
+            else if(p == "strided") pattern_kind = STRIDED;
+            else if(p == "uniform") pattern_kind = UNIFORM;
+            else if(p == "zipf") pattern_kind = ZIPF;
+            else if(p == "hotset") pattern_kind = HOTSET;
+            else{
+                cerr << "Unknown pattern " << p << endl;
+                return 1;
+            }
+        }
+        else if(opt.rfind("--access-size=" , 0) == 0) access_size = max(1ULL , strtoull(opt.c_str() + 14 , nullptr , 10));
+        else if(opt.rfind("--stride=" , 0) == 0) stride_bytes = max(1ULL , strtoull(opt.c_str() + 9 , nullptr , 10));
+        else if(opt.rfind("--zipf=" , 0) == 0) zipf_theta = atof(opt.c_str() + 7);
+        else if(opt.rfind("--hot=" , 0) == 0){
+            // The hot set is a part of the region: 0 < F <= 1 , 0 <= P <= 100
+            if(sscanf(opt.c_str() + 6 , "%lf:%d" , &hot_fraction , &hot_pct) != 2 || !(hot_fraction > 0 && hot_fraction <= 1)
+               || hot_pct < 0 || hot_pct > 100){
+                cerr << "--hot=F:P needs 0 < F <= 1 and 0 <= P <= 100" << endl;
+                return 1;
+            }
+        }
+        else if(opt.rfind("--read-pct=" , 0) == 0) read_pct = min(100 , max(0 , atoi(opt.c_str() + 11)));
+        else if(opt.rfind("--backend=" , 0) == 0) backend_list = opt.substr(10);
+        else{
+            cerr << "Unknown option " << opt << endl;
             return 1;
         }
     }
 
-    cout << "Offset: 0x" << hex << F << " Value: " << dec << (int)X << " Verified" << endl;
-    usleep(10000);        // Sleep 10ms to slow output
+    writes_per_batch = max(1 , writes_per_batch);
+    zipf_theta = min(0.9999 , max(0.01 , zipf_theta));     // the generator needs 0 < theta < 1
+    if(access_size > file_size / num_threads){
+        cerr << "Access size larger than a thread's region" << endl;
+        return 1;
+    }
+    verifies_per_batch = max(0 , min(verifies_per_batch , writes_per_batch));
+    run_tag = splitmix64(seed ^ 0xA5A5A5A5ULL);
+    page_size = sysconf(_SC_PAGESIZE);
+    page_shift = __builtin_ctzl(page_size);
+
+    if(sync_mode == "async") sync_flags = MS_ASYNC;
+    else if(sync_mode == "strict") sync_flags = MS_SYNC;
+    else if(sync_mode != "none"){
+        cerr << "Unknown sync mode " << sync_mode << endl;
+        return 1;
+    }
+
+    vector<BackendKind> kinds;
+    for(size_t pos = 0 ; pos < backend_list.size() ; ){
+        size_t comma = backend_list.find(',' , pos);
+        if(comma == string::npos) comma = backend_list.size();
+        string b = backend_list.substr(pos , comma - pos);
+        pos = comma + 1;
+
+        if(b == "all"){
+            kinds = {MMAP , PREAD , DIRECT , URING};
+            continue;
+        }
+        int k = 0;
+        while(k < 4 && b != backend_names[k]) k++;
+        if(k == 4){
+            cerr << "Unknown backend " << b << endl;
+            return 1;
+        }
+        kinds.push_back((BackendKind)k);
+    }
+
+    dirty_words = ((file_size >> page_shift) + 64) / 64;
+    dirty_bits = new atomic<uint64_t>[dirty_words]();
+
+    // Open or Create file
+    int fd = open(FILE_NAME , O_RDWR | O_CREAT , 0666);
+
+    if(fd < 0){
+        perror("open");
+        return 1;
+    }
+    file_fd = fd;
+
+    // If file was smaller , it extends it(extra space filled wiht zeroes)
+    // If file wasd bigger , it truncates
+
+    if(ftruncate(fd , file_size) == -1){
+        perror("ftruncate");
+        return 1;
+    }
+
+
+    calibrate_ticks();
+
+    // Same seed for every backend , so they all see the same offsets
+    vector<BackendResult> results;
+    for(BackendKind kind : kinds){
+        BackendResult r;
+        if(run_backend(kind , seed , r)) results.push_back(r);
+    }
+
+    if(results.size() > 1) print_comparison(results);
+
+    uint64_t total_mismatches = 0;
+    for(const BackendResult& r : results) total_mismatches += r.mismatches;
+
+    delete[] dirty_bits;
+    close(fd);
+    return (total_mismatches || results.size() != kinds.size()) ? 1 : 0;
 }
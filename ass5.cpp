@@ -2,70 +2,221 @@
 //  Shared memory allows multiple processes (or threads in some cases)
 //  to access the same memory space
 
+//  Segment layout (sized at run time , so millions of pairs fit):
+//    SegmentHeader   magic , n , byte offset of every array , the process-shared
+//                    mutex / condition variables and the lock-free counters
+//    X[n] Y[n] A[n] B[n] C[n] computedA[n] computedB[n] computedC[n]
+//                    one array per field (SoA) , each starting on a cache line
+//  Offsets instead of pointers , so every process can attach at its own address.
+//
+//  Modes:
+//    --mode=mutex     (default) one global mutex + condition variables , as before
+//    --mode=lockfree  every stage publishes a sequence counter in the header
+//                     (items done so far , item k lives in slot k % n) ;
+//                     A and B publish after each batch , C takes everything
+//                     that is ready in one go. A waiter spins a little , then
+//                     sleeps on the counter with futex() ; a publisher only
+//                     calls futex(WAKE) when someone announced that it sleeps.
+//    --procs          A , B and C run as three processes , each attaching the
+//                     segment itself , instead of three threads (both modes:
+//                     the mutex and condition variables are PTHREAD_PROCESS_SHARED ,
+//                     the futexes are not FUTEX_PRIVATE)
+//    --hugepages      back the segment with huge pages (SHM_HUGETLB) ; falls back
+//                     to normal pages if none are reserved (vm.nr_hugepages)
+//    --rounds=R       run the n pairs R times through the pipeline (default 1) ,
+//                     so there are enough items to measure
+//    --batch=K        lock-free mode: items per publish (default 16 , at most n)
+//    --delay=US       simulated work per item and stage (default 10000 us ,
+//                     0 to measure only the synchronization)
+//    --spin=N         lock-free mode: polls before sleeping (default 2000 , 0 on a
+//                     single CPU where spinning only delays the thread it waits for)
+//  At the end items/sec are printed for the mode , so both can be compared:
+//    ./ass5 100 --rounds=10000 --delay=0 --mode=mutex
+//    ./ass5 100 --rounds=10000 --delay=0 --mode=lockfree --batch=32
+//    ./ass5 5000000 --delay=0 --mode=lockfree --batch=1024 --procs --hugepages
+//  Compile: g++ -O2 -pthread ass5.cpp -o ass5
+
 #include <iostream>
 #include <thread> // for multithreading
-#include <mutex>  // for thread synchronization
-#include <condition_variable>
+#include <pthread.h> // process-shared mutex and condition variables
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
+#include <cstdio>    // perror()
 #include <sys/ipc.h> // for shared memory location
 #include <sys/shm.h> // same as above
+#include <sys/wait.h> // waitpid()
+#include <csignal>    // kill()
 #include <unistd.h>  // header file in C/C++ for POSIX (Unix-like) systems.
+#include <sys/syscall.h> // syscall(SYS_futex)
+#include <linux/futex.h> // FUTEX_WAIT , FUTEX_WAKE
 #include <iomanip>
 
-#define MAX_PAIRS 100
+using namespace std;
+
+#define SEGMENT_MAGIC 0x50414952 // "PAIR"
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define SPIN_LIMIT 2000 // polls before a waiter goes to sleep on the futex , with more than one CPU
+#define PRINT_PAIRS 20  // rows of the result table that are printed
 
-struct SharedData
+struct SegmentHeader
 {
-    int X[MAX_PAIRS];
-    int Y[MAX_PAIRS];
-    int A[MAX_PAIRS];
-    int B[MAX_PAIRS];
+    uint32_t magic; // SEGMENT_MAGIC once the header is filled in
+    uint32_t n;     // Number of (X,Y) pairs.
+    uint64_t bytes; // whole segment , header included
+
+    // Byte offsets of the arrays from the start of the segment
+    uint64_t offX, offY, offA, offB, offC;
+    uint64_t offComputedA, offComputedB, offComputedC;
 
-    double C[MAX_PAIRS];
+    // computedA/B/C hold the round in which a stage last finished a value (0 = not yet).
+    // Before A or B overwrite slot i for round r , C must be done with round r - 1.
 
-    bool computedA[MAX_PAIRS];
-    bool computedB[MAX_PAIRS];
-    bool computedC[MAX_PAIRS];
+    pthread_mutex_t mtx;           // Avoids of Race Condition
+    pthread_cond_t cvA, cvB, cvC;  // For respective stages to get notified
 
-    // computedA/B/C are boolean flags to indicate if a particular thread has finished computing a value.
+    // Lock-free mode: items published so far by each stage , each on its own cache line
+    alignas(64) atomic<uint32_t> seqA;
+    alignas(64) atomic<uint32_t> seqB;
+    alignas(64) atomic<uint32_t> seqC;
 
-    int n; // Number of (X,Y) pairs.
+    // Number of stages asleep (or about to be) on the counters
+    alignas(64) atomic<uint32_t> waitingC;  // C on seqA / seqB
+    atomic<uint32_t> waitingAB;             // A and B on seqC
+
+    // Summed over all stages , whether threads or processes
+    atomic<long> futex_waits, futex_wakes;
 };
 
-SharedData *shm_ptr;              // pointer to shared memory
-mutex mtx;                        // Avoids of Race Condition
-condition_variable cvA, cvB, cvC; // For respective threads to get notified
+// Where the arrays are in this process
+struct Pairs
+{
+    int *X, *Y, *A, *B;
+    double *C;
+    int *computedA, *computedB, *computedC;
+    uint32_t n;
+};
+
+SegmentHeader *shm_ptr; // pointer to shared memory
+Pairs pairs;
+
+int rounds = 1;
+int batch = 16;
+int delay_us = 10000;
+int spin_limit = SPIN_LIMIT;
+
+// Header first , then every array on its own cache line
+uint64_t layout(SegmentHeader &h, uint32_t n)
+{
+    auto line = [](uint64_t off)
+    { return (off + 63) & ~63ULL; };
+
+    uint64_t off = line(sizeof(SegmentHeader));
+    h.offX = off;
+    off = line(off + n * sizeof(int));
+    h.offY = off;
+    off = line(off + n * sizeof(int));
+    h.offA = off;
+    off = line(off + n * sizeof(int));
+    h.offB = off;
+    off = line(off + n * sizeof(int));
+    h.offC = off;
+    off = line(off + n * sizeof(double));
+    h.offComputedA = off;
+    off = line(off + n * sizeof(int));
+    h.offComputedB = off;
+    off = line(off + n * sizeof(int));
+    h.offComputedC = off;
+    off = line(off + n * sizeof(int));
+    return off;
+}
+
+//  shmat() → Attach shared memory segment to your process’s address space.
+//  The arrays are found through the header , wherever the segment landed.
+bool attach(int shmid)
+{
+    shm_ptr = (SegmentHeader *)shmat(shmid, NULL, 0); // (id , OS to choose where to attach , flag)
+
+    if (shm_ptr == (void *)-1)
+    {
+        perror("shmat");
+        return false;
+    }
+
+    if (shm_ptr->magic != SEGMENT_MAGIC)
+    {
+        cout << "Segment " << shmid << " has no pair header" << endl;
+        shmdt(shm_ptr);
+        return false;
+    }
+
+    char *base = (char *)shm_ptr;
+    pairs.n = shm_ptr->n;
+    pairs.X = (int *)(base + shm_ptr->offX);
+    pairs.Y = (int *)(base + shm_ptr->offY);
+    pairs.A = (int *)(base + shm_ptr->offA);
+    pairs.B = (int *)(base + shm_ptr->offB);
+    pairs.C = (double *)(base + shm_ptr->offC);
+    pairs.computedA = (int *)(base + shm_ptr->offComputedA);
+    pairs.computedB = (int *)(base + shm_ptr->offComputedB);
+    pairs.computedC = (int *)(base + shm_ptr->offComputedC);
+    return true;
+}
 
 // A = X*Y
 void computeA()
 {
-    for (int i = 0; i < shm_ptr->n; i++)
+    for (int r = 1; r <= rounds; r++)
     {
-        uniqe_lock<mutex> lock(mtx);
-        shm_ptr->A[i] = shm_ptr->X[i] * shm_ptr->Y[i];
-        shm_ptr->computedA[i] = true;
+        for (uint32_t i = 0; i < pairs.n; i++)
+        {
+            pthread_mutex_lock(&shm_ptr->mtx);
+
+            // Slot i still holds the last round until C has used it
+            while (pairs.computedC[i] < r - 1)
+            {
+                pthread_cond_wait(&shm_ptr->cvC, &shm_ptr->mtx);
+            }
+
+            pairs.A[i] = pairs.X[i] * pairs.Y[i];
+            pairs.computedA[i] = r;
 
-        cvA.notify_all(); // notify C
-        lock.unlock();
-        usleep(10000);
+            pthread_cond_broadcast(&shm_ptr->cvA); // notify C
+            pthread_mutex_unlock(&shm_ptr->mtx);
+            if (delay_us)
+                usleep(delay_us);
 
-        // Simulates computation delay to better demonstrate parallel execution
+            // Simulates computation delay to better demonstrate parallel execution
+        }
     }
 }
 
 //  B = 2*X + 2*Y + 1
 void computeB()
 {
-    for (int i = 0; i < shm_ptr->n; i++)
+    for (int r = 1; r <= rounds; r++)
     {
-        unique_lock<mutex> lock(mtx);
-        shm_ptr->B[i] = 2 * shm_ptr->X[i] + 2 * shm_ptr->Y[i] + 1;
-        shm_ptr->computedB[i] = true;
+        for (uint32_t i = 0; i < pairs.n; i++)
+        {
+            pthread_mutex_lock(&shm_ptr->mtx);
+
+            while (pairs.computedC[i] < r - 1)
+            {
+                pthread_cond_wait(&shm_ptr->cvC, &shm_ptr->mtx);
+            }
+
+            pairs.B[i] = 2 * pairs.X[i] + 2 * pairs.Y[i] + 1;
+            pairs.computedB[i] = r;
 
-        cvB.notify_all();
-        lock.unlock();
+            pthread_cond_broadcast(&shm_ptr->cvB);
+            pthread_mutex_unlock(&shm_ptr->mtx);
 
-        usleep(10000);
+            if (delay_us)
+                usleep(delay_us);
+        }
     }
 }
 
@@ -73,113 +224,451 @@ void computeB()
 
 void computeC()
 {
-    for (int i = 0; i < shm_ptr->n; i++)
+    for (int r = 1; r <= rounds; r++)
     {
-        unique_lock<mutex> lock(mtx);
-
-        // Wait for A[i] to be computed
-        while (!shm_ptr->computedA[i])
+        for (uint32_t i = 0; i < pairs.n; i++)
         {
-            cvA.wait(lock); // Unlcok mutex and waits
+            pthread_mutex_lock(&shm_ptr->mtx);
+
+            // Wait for A[i] to be computed
+            while (pairs.computedA[i] < r)
+            {
+                pthread_cond_wait(&shm_ptr->cvA, &shm_ptr->mtx); // Unlcok mutex and waits
+            }
+
+            // Wait for B[i] to be computed
+            while (pairs.computedB[i] < r)
+            {
+                pthread_cond_wait(&shm_ptr->cvB, &shm_ptr->mtx);
+            }
+
+            // Compute C[i]
+
+            if (pairs.A[i] != 0)
+            {
+                pairs.C[i] = pairs.B[i] / pairs.A[i];
+            }
+            else
+            {
+                pairs.C[i] = 0;
+            }
+
+            pairs.computedC[i] = r;
+            pthread_cond_broadcast(&shm_ptr->cvC); // slot i can be reused by A and B
+
+            pthread_mutex_unlock(&shm_ptr->mtx);
+            if (delay_us)
+                usleep(delay_us);
         }
+    }
+}
 
-        // Wait for B[i] to be computed
-        while (!shm_ptr->computedB)
-        {
-            cvB.wait(lock);
-        }
+// ---------------- lock-free mode ----------------
+
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Not FUTEX_PRIVATE: the counters live in a shared memory segment
+void futex_wait(atomic<uint32_t> &word, uint32_t expected)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, expected, NULL, NULL, 0);
+    shm_ptr->futex_waits++;
+}
+
+void futex_wake(atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    shm_ptr->futex_wakes++;
+}
+
+// Spin until ready() holds , then sleep on word until it changes.
+// The waiter announces itself before its last check and the publisher stores
+// the counter before it looks for waiters , so one of the two always sees the other.
+template <class Ready>
+void wait_until(atomic<uint32_t> &word, atomic<uint32_t> &waiting, Ready ready)
+{
+    for (int spin = 0; spin < spin_limit; spin++)
+    {
+        if (ready())
+            return;
+        cpu_relax();
+    }
+
+    while (!ready())
+    {
+        uint32_t seen = word.load();
+        waiting.fetch_add(1);
+        if (!ready())
+            futex_wait(word, seen); // returns at once if word is no longer "seen"
+        waiting.fetch_sub(1);
+    }
+}
+
+// New counter value , and a wake-up only if somebody sleeps on it
+void publish(atomic<uint32_t> &word, uint32_t value, atomic<uint32_t> &waiting)
+{
+    word.store(value);
+    if (waiting.load())
+        futex_wake(word);
+}
+
+// A and B: compute a batch into free slots , then publish it with one store
+template <class Compute>
+void produce(atomic<uint32_t> &seq, Compute compute)
+{
+    uint32_t n = pairs.n;
+    uint32_t total = n * rounds;
+
+    for (uint32_t k = 0; k < total;)
+    {
+        uint32_t count = min<uint32_t>(batch, total - k);
 
-        // Compute C[i]
+        // The slots of items k .. k+count-1 are free once C is past item k+count-1-n
+        wait_until(shm_ptr->seqC, shm_ptr->waitingAB, [&]
+                   { return k + count - shm_ptr->seqC.load(memory_order_acquire) <= n; });
 
-        if (shm_ptr->A[i] != 0)
+        for (uint32_t j = k; j < k + count; j++)
         {
-            shm_ptr->C[i] = shm_ptr->B[i] / shm_ptr->A[i];
+            compute(j % n);
+            if (delay_us)
+                usleep(delay_us);
         }
-        else
+
+        k += count;
+        publish(seq, k, shm_ptr->waitingC);
+    }
+}
+
+void computeA_lockfree()
+{
+    produce(shm_ptr->seqA, [](uint32_t i)
+            { pairs.A[i] = pairs.X[i] * pairs.Y[i]; });
+}
+
+void computeB_lockfree()
+{
+    produce(shm_ptr->seqB, [](uint32_t i)
+            { pairs.B[i] = 2 * pairs.X[i] + 2 * pairs.Y[i] + 1; });
+}
+
+// C: everything A and B have both published , in one pass , then one store
+void computeC_lockfree()
+{
+    uint32_t n = pairs.n;
+    uint32_t total = n * rounds;
+
+    for (uint32_t k = 0; k < total;)
+    {
+        wait_until(shm_ptr->seqA, shm_ptr->waitingC, [&]
+                   { return shm_ptr->seqA.load(memory_order_acquire) != k; });
+        wait_until(shm_ptr->seqB, shm_ptr->waitingC, [&]
+                   { return shm_ptr->seqB.load(memory_order_acquire) != k; });
+
+        uint32_t ready = min(shm_ptr->seqA.load(memory_order_acquire) - k, shm_ptr->seqB.load(memory_order_acquire) - k);
+
+        for (uint32_t j = k; j < k + ready; j++)
         {
-            shm_ptr->C[i] = 0;
+            uint32_t i = j % n;
+            if (pairs.A[i] != 0)
+            {
+                pairs.C[i] = pairs.B[i] / pairs.A[i];
+            }
+            else
+            {
+                pairs.C[i] = 0;
+            }
+            if (delay_us)
+                usleep(delay_us);
         }
 
-        shm_ptr->computedC[i] = true;
-        ;
-        cvC.notify_all();
+        k += ready;
+        publish(shm_ptr->seqC, k, shm_ptr->waitingAB);
+    }
+}
 
-        lock.unlock();
-        usleep(10000);
+// One stage in a process of its own: attach the segment by id , run , leave
+pid_t spawn(int shmid, void (*stage)())
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        shmdt(shm_ptr); // the copy inherited from the parent , attach like an unrelated process
+        if (!attach(shmid))
+            _exit(1);
+        stage();
+        shmdt(shm_ptr);
+        _exit(0);
     }
+    if (pid < 0)
+        perror("fork");
+    return pid;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    if (argc < 2)
+    {
+        cout << "Usage : " << argv[0] << " < number of random pairs> [--mode=mutex|lockfree] [--procs] [--hugepages]"
+             << " [--rounds=R] [--batch=K] [--delay=US] [--spin=N]" << endl;
+        return 1;
+    }
+
+    long long n = stoll(argv[1]);
+
+    // The counters are 32 bit (futex words) , so are the indices
+    if (n <= 0 || n > INT32_MAX / 2)
     {
-        cout << "Usage : " << argv[0] << " < number of random pairs>" << endl;
+        cout << " Number of pairs must be between 1 and " << INT32_MAX / 2 << endl;
         return 1;
     }
 
-    int n = stoi(argv[1]);
+    string mode = "mutex";
+    bool procs = false, hugepages = false;
+    if (thread::hardware_concurrency() <= 1)
+        spin_limit = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt.rfind("--mode=", 0) == 0)
+            mode = opt.substr(7);
+        else if (opt == "--procs")
+            procs = true;
+        else if (opt == "--hugepages")
+            hugepages = true;
+        else if (opt.rfind("--rounds=", 0) == 0)
+            rounds = max(1, atoi(opt.c_str() + 9));
+        else if (opt.rfind("--batch=", 0) == 0)
+            batch = max(1, atoi(opt.c_str() + 8));
+        else if (opt.rfind("--delay=", 0) == 0)
+            delay_us = max(0, atoi(opt.c_str() + 8));
+        else if (opt.rfind("--spin=", 0) == 0)
+            spin_limit = max(0, atoi(opt.c_str() + 7));
+        else
+        {
+            cout << "Unknown option " << opt << endl;
+            return 1;
+        }
+    }
+
+    if (mode != "mutex" && mode != "lockfree")
+    {
+        cout << "Unknown mode " << mode << endl;
+        return 1;
+    }
 
-    if (n <= 0 || n > MAX_PAIRS)
+    if ((uint64_t)n * rounds > UINT32_MAX / 2)
     {
-        cout << " Number of pairs must be between 1 and " << MAX_PAIRS << endl;
+        cout << "Too many items , lower --rounds" << endl;
         return 1;
     }
 
-    // File to Key
-    key_t key = ftok("shmfile", 65);
+    // A batch can never be larger than the slots there are
+    batch = min<long long>(batch, n);
+
+    SegmentHeader shape;
+    uint64_t bytes = layout(shape, n);
 
     // Shared Memory Segment
+    // IPC_PRIVATE -> a new segment every run , sized for this n (a fixed ftok() key
+    //                could find a segment of another size from an earlier run) ;
+    //                the stage processes get its id
     // 0666 -> file permissions
-    // IPC_CREAT -> Flag to create the segment if it doesn’t already exist
+    // SHM_HUGETLB -> huge pages , the size must be a multiple of the huge page size
 
-    int shmid = shmget(key, sizeof(SharedData), 0666 | IPC_CREAT);
+    int shmid = -1;
+    if (hugepages)
+    {
+        uint64_t huge_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        shmid = shmget(IPC_PRIVATE, huge_bytes, 0666 | IPC_CREAT | SHM_HUGETLB);
+        if (shmid < 0)
+        {
+            perror("shmget SHM_HUGETLB");
+            cout << "No huge pages (see vm.nr_hugepages) , using normal pages" << endl;
+            hugepages = false;
+        }
+        else
+            bytes = huge_bytes;
+    }
+    if (shmid < 0)
+        shmid = shmget(IPC_PRIVATE, bytes, 0666 | IPC_CREAT);
 
-    //  shmat() → Attach shared memory segment to your process’s address space.
-    shm_ptr = (SharedData *)shmat(shmid, NULL, 0); // (id , OS to choose where to attach , flag)
+    if (shmid < 0)
+    {
+        perror("shmget");
+        return 1;
+    }
 
-    if (shm_ptr == (void *)-1)
+    // Header first , attach() reads the offsets from it
+    SegmentHeader *hdr = (SegmentHeader *)shmat(shmid, NULL, 0);
+    if (hdr == (void *)-1)
     {
         perror("shmat");
+        shmctl(shmid, IPC_RMID, NULL);
+        return 1;
+    }
+    hdr->n = n;
+    hdr->bytes = bytes;
+    layout(*hdr, n);
+
+    // Process-shared , so they work the same from threads and from the stage processes
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&hdr->mtx, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&hdr->cvA, &cattr);
+    pthread_cond_init(&hdr->cvB, &cattr);
+    pthread_cond_init(&hdr->cvC, &cattr);
+    pthread_condattr_destroy(&cattr);
+
+    hdr->seqA = 0;
+    hdr->seqB = 0;
+    hdr->seqC = 0;
+    hdr->waitingC = 0;
+    hdr->waitingAB = 0;
+    hdr->futex_waits = 0;
+    hdr->futex_wakes = 0;
+    hdr->magic = SEGMENT_MAGIC;
+    shmdt(hdr);
+
+    if (!attach(shmid))
+    {
+        shmctl(shmid, IPC_RMID, NULL);
         return 1;
     }
 
     // Initialize shared memory with random values
-    shm_ptr->n = n;
-    for (int i = 0; i < n; i++)
+    for (uint32_t i = 0; i < pairs.n; i++)
     {
-        shm_ptr->X[i] = rand() % 10;
-        shm_ptr->Y[i] = rand() % 10;
+        pairs.X[i] = rand() % 10;
+        pairs.Y[i] = rand() % 10;
 
-        shm_ptr->computedA[i] = false;
-        shm_ptr->computedB[i] = false;
-        shm_ptr->computedC[i] = false;
+        pairs.computedA[i] = 0;
+        pairs.computedB[i] = 0;
+        pairs.computedC[i] = 0;
     }
 
-    // Create Threads
-    thread Th1(computeA);
-    thread Th2(computeB);
-    thread Th3(computeC);
+    // Mark the segment for removal now: it goes away once the last process
+    // detaches , even if one of them crashes
+    //    (Linux still lets the stage processes shmat() a segment marked IPC_RMID)
+    // SHared Memory ConTroL
+    shmctl(shmid, IPC_RMID, NULL);
+    // IPC_RMID: “Remove (delete) this shared memory segment”
 
-    // Wait for threads to join
-    Th1.join();
-    Th2.join();
-    Th3.join();
+    bool lockfree = (mode == "lockfree");
+    void (*stageA)() = lockfree ? computeA_lockfree : computeA;
+    void (*stageB)() = lockfree ? computeB_lockfree : computeB;
+    void (*stageC)() = lockfree ? computeC_lockfree : computeC;
+
+    auto start = chrono::steady_clock::now();
+    bool failed = false;
+
+    if (procs)
+    {
+        // Create Processes
+        pid_t pids[3] = {spawn(shmid, stageA), spawn(shmid, stageB), spawn(shmid, stageC)};
+
+        // A stage that is missing or died leaves the others waiting forever
+        auto stop_all = [&]
+        {
+            for (pid_t pid : pids)
+                if (pid > 0)
+                    kill(pid, SIGKILL);
+        };
+
+        int running = 0;
+        for (pid_t pid : pids)
+        {
+            if (pid > 0)
+                running++;
+            else
+                failed = true;
+        }
+        if (failed)
+            stop_all();
+
+        // Wait for processes to exit , in whatever order they finish
+        while (running > 0)
+        {
+            int status = 0;
+            if (waitpid(-1, &status, 0) < 0)
+                break;
+            running--;
+
+            if (!failed && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+            {
+                failed = true;
+                stop_all();
+            }
+        }
+    }
+    else
+    {
+        // Create Threads
+        thread Th1(stageA);
+        thread Th2(stageB);
+        thread Th3(stageC);
+
+        // Wait for threads to join
+        Th1.join();
+        Th2.join();
+        Th3.join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (failed)
+    {
+        cout << "A stage process failed" << endl;
+        shmdt(shm_ptr);
+        return 1;
+    }
 
     // Print results
     cout << "Pairs(X,Y) | A | B | C\n";
     cout << "-------------------------------\n";
-    for (int i = 0; i < n; i++)
+    for (uint32_t i = 0; i < pairs.n && i < PRINT_PAIRS; i++)
+    {
+        cout << "(" << pairs.X[i] << "," << pairs.Y[i] << ") | "
+             << pairs.A[i] << " | " << pairs.B[i] << " | "
+             << fixed << setprecision(2) << pairs.C[i] << "\n";
+    }
+    if (pairs.n > PRINT_PAIRS)
+        cout << "... " << pairs.n - PRINT_PAIRS << " more\n";
+
+    // Every pair , so a lost update between the stages shows up
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < pairs.n; i++)
     {
-        cout << "(" << shm_ptr->X[i] << "," << shm_ptr->Y[i] << ") | "
-             << shm_ptr->A[i] << " | " << shm_ptr->B[i] << " | "
-             << fixed << setprecision(2) << shm_ptr->C[i] << "\n";
+        int a = pairs.X[i] * pairs.Y[i];
+        int b = 2 * pairs.X[i] + 2 * pairs.Y[i] + 1;
+        double c = a != 0 ? b / a : 0;
+        if (pairs.A[i] != a || pairs.B[i] != b || pairs.C[i] != c)
+            wrong++;
     }
 
+    // Throughput: an item is one pair through all three stages
+    long items = (long)n * rounds;
+    cout << "\nMode: " << mode << (procs ? " , 3 processes" : " , 3 threads");
+    if (lockfree)
+        cout << " , batch " << batch << " , spin " << spin_limit;
+    cout << " , delay " << delay_us << " us\n";
+    cout << "Segment: " << bytes / 1024 << " KB , " << (hugepages ? "huge pages" : "normal pages") << "\n";
+    cout << items << " items (" << n << " pairs x " << rounds << " rounds) in "
+         << setprecision(6) << seconds << " s -> " << setprecision(0) << items / seconds << " items/sec\n";
+    if (lockfree)
+        cout << "futex waits: " << shm_ptr->futex_waits << " , wakes: " << shm_ptr->futex_wakes << "\n";
+    cout << "Wrong results: " << wrong << "\n";
+
     //  Detach shared memory from this process
     shmdt(shm_ptr);
-
-    // SHared Memory ConTroL
-    shmct(shmid, IPC_RMID, NULL);
-    // IPC_RMID: “Remove (delete) this shared memory segment”
-    return 0;
+    return wrong ? 1 : 0;
 }
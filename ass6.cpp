@@ -3,18 +3,62 @@
 #include <thread>
 #include <random>
 #include <chrono>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <immintrin.h>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include "matrix_common.h"   // pinning, FirstTouchAllocator, random_element, popcount kernels, WorkStealingPool
 using namespace std;
 
-vector<unsigned char> A, B, C;
+// Compile: g++ -O2 -pthread ass6.cpp -o ass6   (matrix_common.h, shared with ass3.cpp, next to it)
+// Usage:   ./ass6 <N> <threads> <mod> <print_switch> [--kernel=auto|scalar|sse42|avx2|avx512|bitpacked] [--verify]
+//                 [--sched=static|steal] [--tile=T] [--repeat=R] [--seed=S] [--pin]
+//
+// A and B are filled in parallel from a counter-based generator (element idx
+// depends only on seed and idx), using the same row bands as the static
+// multiply so each thread first-touches the rows it later computes.
+// --pin pins thread t to the t-th CPU in the process's allowed set.
+//
+// Only sum % 256 is kept, so the products can wrap in 16-bit lanes and the
+// low byte is still exact. The SIMD kernels use that: each thread walks its
+// rows in i-k-j order, accumulating a*B[k][j] into a 16-bit row buffer for
+// K_BLOCK values of k, then adds the low bytes into C (wrapping 8-bit add).
+//
+// With mod = 2 (auto picks it then) the bitpacked kernel packs rows of A and
+// columns of B 64 entries per word and C[i][j] = popcount(row & column) % 256.
+
+// Pages are first touched by init_matrices()
+vector<unsigned char, FirstTouchAllocator<unsigned char>> A, B, C;
 int N, num_threads;
 
-void multiply(int tid) {
+void init_matrices(int tid, uint64_t seed, unsigned mod) {
+    pin_thread(tid);
     int rows_per_thread = N / num_threads;
     int start = tid * rows_per_thread;
     int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    for (size_t idx = (size_t)start*N; idx < (size_t)end*N; ++idx) {
+        A[idx] = random_element(seed, 0, idx, mod);
+        B[idx] = random_element(seed, 1, idx, mod);
+        C[idx] = 0;
+    }
+}
+
+const int K_BLOCK = 128;   // rows of B streamed per pass (K_BLOCK * N bytes stays in L2)
 
-    for (int i = start; i < end; ++i) {
-        for (int j = 0; j < N; ++j) {
+// Rows [r0, r1) x columns [c0, c1) of C
+void multiply_tile(int r0, int r1, int c0, int c1) {
+    for (int i = r0; i < r1; ++i) {
+        for (int j = c0; j < c1; ++j) {
             int sum = 0;
             for (int k = 0; k < N; ++k)
                 sum += A[i*N + k] * B[k*N + j];
@@ -23,34 +67,277 @@ void multiply(int tid) {
     }
 }
 
+void multiply(int tid) {
+    pin_thread(tid);
+    int rows_per_thread = N / num_threads;
+    int start = tid * rows_per_thread;
+    int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    multiply_tile(start, end, 0, N);
+}
+
+// acc[j] += a * b[j] for j in [0, n), wrapping in 16 bits
+typedef void (*axpy_fn)(uint16_t* acc, const unsigned char* b, uint16_t a, int n);
+
+void axpy_scalar(uint16_t* acc, const unsigned char* b, uint16_t a, int n) {
+    for (int j = 0; j < n; ++j)
+        acc[j] += (uint16_t)(a * b[j]);
+}
+
+__attribute__((target("sse4.2")))
+void axpy_sse42(uint16_t* acc, const unsigned char* b, uint16_t a, int n) {
+    __m128i va = _mm_set1_epi16(a);
+    int j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m128i vb = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(b + j)));
+        __m128i vc = _mm_loadu_si128((const __m128i*)(acc + j));
+        _mm_storeu_si128((__m128i*)(acc + j), _mm_add_epi16(vc, _mm_mullo_epi16(va, vb)));
+    }
+    axpy_scalar(acc + j, b + j, a, n - j);
+}
+
+__attribute__((target("avx2")))
+void axpy_avx2(uint16_t* acc, const unsigned char* b, uint16_t a, int n) {
+    __m256i va = _mm256_set1_epi16(a);
+    int j = 0;
+    for (; j + 16 <= n; j += 16) {
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(b + j)));
+        __m256i vc = _mm256_loadu_si256((const __m256i*)(acc + j));
+        _mm256_storeu_si256((__m256i*)(acc + j), _mm256_add_epi16(vc, _mm256_mullo_epi16(va, vb)));
+    }
+    axpy_scalar(acc + j, b + j, a, n - j);
+}
+
+__attribute__((target("avx512bw")))
+void axpy_avx512(uint16_t* acc, const unsigned char* b, uint16_t a, int n) {
+    __m512i va = _mm512_set1_epi16(a);
+    int j = 0;
+    for (; j + 32 <= n; j += 32) {
+        __m512i vb = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(b + j)));
+        __m512i vc = _mm512_loadu_si512((const void*)(acc + j));
+        _mm512_storeu_si512((void*)(acc + j), _mm512_add_epi16(vc, _mm512_mullo_epi16(va, vb)));
+    }
+    axpy_scalar(acc + j, b + j, a, n - j);
+}
+
+axpy_fn axpy = axpy_scalar;
+
+// Picks the widest kernel the CPU supports (CPUID via __builtin_cpu_supports)
+string detect_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) return "avx512";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    if (__builtin_cpu_supports("sse4.2")) return "sse42";
+    return "scalar";
+}
+
+// SIMD version of multiply_tile, C must be zeroed first
+void multiply_simd_tile(int r0, int r1, int c0, int c1) {
+    int w = c1 - c0;
+    thread_local vector<uint16_t> acc;
+    acc.resize(w);
+
+    for (int kk = 0; kk < N; kk += K_BLOCK) {
+        int kend = min(kk + K_BLOCK, N);
+        for (int i = r0; i < r1; ++i) {
+            fill(acc.begin(), acc.end(), 0);
+            for (int k = kk; k < kend; ++k)
+                axpy(acc.data(), &B[k*N + c0], A[i*N + k], w);
+            for (int j = 0; j < w; ++j)
+                C[i*N + c0 + j] += (unsigned char)acc[j];
+        }
+    }
+}
+
+void multiply_simd(int tid) {
+    pin_thread(tid);
+    int rows_per_thread = N / num_threads;
+    int start = tid * rows_per_thread;
+    int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    multiply_simd_tile(start, end, 0, N);
+}
+
+// Bit-packed kernel for 0/1 matrices: Ap row i = A[i][*], Btp row j = B[*][j]
+vector<u64, FirstTouchAllocator<u64>> Ap, Btp;
+int W;
+
+// Thread tid generates its band of Ap/Btp rows directly (the u8 A and B are
+// never allocated in bitpacked mode) and zeroes its rows of C
+void init_bitpacked(int tid, uint64_t seed) {
+    pin_thread(tid);
+    int rows_per_thread = N / num_threads;
+    int start = tid * rows_per_thread;
+    int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    for (int r = start; r < end; ++r) {
+        random_bit_row(&Ap[(size_t)r*W], seed, 0, N, r, false);
+        random_bit_row(&Btp[(size_t)r*W], seed, 1, N, r, true);
+    }
+    fill(C.begin() + (size_t)start*N, C.begin() + (size_t)end*N, 0);
+}
+
+// A and B alone, for --verify in bitpacked mode (C holds the result by then)
+void init_inputs(int tid, uint64_t seed, unsigned mod) {
+    pin_thread(tid);
+    int rows_per_thread = N / num_threads;
+    int start = tid * rows_per_thread;
+    int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    for (size_t idx = (size_t)start*N; idx < (size_t)end*N; ++idx) {
+        A[idx] = random_element(seed, 0, idx, mod);
+        B[idx] = random_element(seed, 1, idx, mod);
+    }
+}
+
+// Columns in blocks of 64 so their packed rows stay in L1
+void multiply_bitpacked_tile(int r0, int r1, int c0, int c1) {
+    for (int jj = c0; jj < c1; jj += 64)
+        for (int i = r0; i < r1; ++i)
+            for (int j = jj; j < min(jj + 64, c1); ++j)
+                C[(size_t)i*N + j] = (unsigned char)and_popcount(&Ap[(size_t)i*W], &Btp[(size_t)j*W], W);
+}
+
+void multiply_bitpacked(int tid) {
+    pin_thread(tid);
+    int rows_per_thread = N / num_threads;
+    int start = tid * rows_per_thread;
+    int end = (tid == num_threads - 1) ? N : start + rows_per_thread;
+    multiply_bitpacked_tile(start, end, 0, N);
+}
+
+
 int main(int argc, char* argv[]) {
-    if (argc != 5) return 1;
+    if (argc < 5) return 1;
     N = stoi(argv[1]);
     num_threads = stoi(argv[2]);
     int mod = stoi(argv[3]);
     bool print_switch = stoi(argv[4]) == 1;
 
-    A.resize(N*N);
-    B.resize(N*N);
-    C.resize(N*N, 0);
+    string kernel = "auto", sched = "static";
+    bool verify = false;
+    int tile = 256, repeat = 1;
+    uint64_t seed = random_device()();
+    for (int a = 5; a < argc; ++a) {
+        string opt = argv[a];
+        if (opt.rfind("--kernel=", 0) == 0) kernel = opt.substr(9);
+        else if (opt == "--verify") verify = true;
+        else if (opt.rfind("--sched=", 0) == 0) sched = opt.substr(8);
+        else if (opt.rfind("--tile=", 0) == 0) tile = max(1, stoi(opt.substr(7)));
+        else if (opt.rfind("--repeat=", 0) == 0) repeat = max(1, stoi(opt.substr(9)));
+        else if (opt.rfind("--seed=", 0) == 0) seed = stoull(opt.substr(7));
+        else if (opt == "--pin") { pin_threads = true; pin_cpus = allowed_cpus(); }
+        else { cerr << "Unknown option: " << opt << "\n"; return 1; }
+    }
 
-    // Initialize matrices
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> dist(0, mod-1);
-    for (int i=0;i<N*N;i++) { A[i]=dist(gen); B[i]=dist(gen); }
+    string best = detect_kernel();
+    if (kernel == "auto") kernel = (mod == 2) ? "bitpacked" : best;
 
-    auto start_time = chrono::high_resolution_clock::now();
+    if (kernel == "bitpacked") {
+        if (mod != 2) { cerr << "The bitpacked kernel needs mod = 2\n"; return 1; }
+        cout << "Popcount: " << select_popcount() << "\n";
+    }
+    else if (kernel == "scalar") axpy = axpy_scalar;
+    else if (kernel == "sse42") axpy = axpy_sse42;
+    else if (kernel == "avx2") axpy = axpy_avx2;
+    else if (kernel == "avx512") axpy = axpy_avx512;
+    else { cerr << "Unknown kernel: " << kernel << "\n"; return 1; }
 
-    vector<thread> threads;
-    for (int i = 0; i < num_threads; ++i)
-        threads.emplace_back(multiply, i);
+    if ((kernel == "avx512" && best != "avx512") ||
+        (kernel == "avx2" && best != "avx512" && best != "avx2") ||
+        (kernel == "sse42" && best == "scalar")) {
+        cerr << "Kernel " << kernel << " not supported on this CPU (best: " << best << ")\n";
+        return 1;
+    }
+    if (sched != "static" && sched != "steal") { cerr << "Unknown scheduler: " << sched << "\n"; return 1; }
+    cout << "Kernel: " << kernel << ", scheduler: " << sched << ", seed: " << seed << "\n";
+
+    // Initialize matrices (resize leaves the pages untouched); bitpacked
+    // only allocates Ap/Btp and C
+    auto init_start = chrono::high_resolution_clock::now();
+    bool packed = kernel == "bitpacked";
+    C.resize((size_t)N*N);
+    if (packed) {
+        W = (N + 63) / 64;
+        Ap.resize((size_t)N*W);
+        Btp.resize((size_t)N*W);
+    } else {
+        A.resize((size_t)N*N);
+        B.resize((size_t)N*N);
+    }
 
+    vector<thread> threads;
+    for (int i = 0; i < num_threads; ++i) {
+        if (packed) threads.emplace_back(init_bitpacked, i, seed);
+        else threads.emplace_back(init_matrices, i, seed, (unsigned)mod);
+    }
     for (auto &t : threads) t.join();
 
-    auto end_time = chrono::high_resolution_clock::now();
-    chrono::duration<double, milli> elapsed = end_time - start_time;
+    chrono::duration<double, milli> init_elapsed = chrono::high_resolution_clock::now() - init_start;
+    cout << "Init time (ms): " << init_elapsed.count() << "\n";
+
+    // Pool and tiles are set up once and reused by every repeat
+    unique_ptr<WorkStealingPool> pool;
+    vector<Tile> tiles;
+    if (sched == "steal") {
+        pool.reset(new WorkStealingPool(num_threads));
+        for (int r = 0; r < N; r += tile)
+            for (int c = 0; c < N; c += tile)
+                tiles.push_back({r, min(r + tile, N), c, min(c + tile, N)});
+    }
+
+    if (packed) {
+        double mb = 1 << 20;
+        cout << "Resident bytes (MB): " << ((Ap.size() + Btp.size())*8.0 + C.size())/mb
+             << " (Ap+Btp+C), " << 3.0*N*N/mb << " with u8 A and B\n";
+    }
+
+    chrono::duration<double, milli> elapsed(0);
+    for (int rep = 0; rep < repeat; ++rep) {
+        fill(C.begin(), C.end(), 0);
+        auto start_time = chrono::high_resolution_clock::now();
+
+        if (pool) {
+            pool->run(tiles, [&](const Tile& t) {
+                if (kernel == "scalar") multiply_tile(t.r0, t.r1, t.c0, t.c1);
+                else if (kernel == "bitpacked") multiply_bitpacked_tile(t.r0, t.r1, t.c0, t.c1);
+                else multiply_simd_tile(t.r0, t.r1, t.c0, t.c1);
+            });
+        } else {
+            threads.clear();
+            for (int i = 0; i < num_threads; ++i)
+                threads.emplace_back(kernel == "scalar" ? multiply : kernel == "bitpacked" ? multiply_bitpacked : multiply_simd, i);
+            for (auto &t : threads) t.join();
+        }
+
+        auto end_time = chrono::high_resolution_clock::now();
+        chrono::duration<double, milli> run_elapsed = end_time - start_time;
+        if (repeat > 1) cout << "Run " << rep + 1 << " (ms): " << run_elapsed.count() << "\n";
+        if (rep == 0 || run_elapsed < elapsed) elapsed = run_elapsed;
+    }
     cout << "Time (ms): " << elapsed.count() << "\n";
+    if (pool) pool->print_stats();
+
+    // Re-run the scalar loop and compare
+    if (verify && kernel != "scalar") {
+        if (packed) {
+            A.resize((size_t)N*N);
+            B.resize((size_t)N*N);
+            threads.clear();
+            for (int i = 0; i < num_threads; ++i) threads.emplace_back(init_inputs, i, seed, (unsigned)mod);
+            for (auto &t : threads) t.join();
+        }
+        auto C_simd = C;
+        fill(C.begin(), C.end(), 0);
+
+        auto ref_start = chrono::high_resolution_clock::now();
+        threads.clear();
+        for (int i = 0; i < num_threads; ++i)
+            threads.emplace_back(multiply, i);
+        for (auto &t : threads) t.join();
+        chrono::duration<double, milli> ref_elapsed = chrono::high_resolution_clock::now() - ref_start;
+
+        cout << "Scalar time (ms): " << ref_elapsed.count() << "\n";
+        cout << "Speedup: " << ref_elapsed.count() / elapsed.count() << "x\n";
+        if (C_simd != C) { cerr << "Verify: MISMATCH\n"; return 1; }
+        cout << "Verify: OK\n";
+    }
 
     return 0;
 }
@@ -0,0 +1,342 @@
+/*
+Benchmark driver for the matrix multiplication programs
+
+
+Program Description:
+- Runs ass3.cpp (unsigned int elements , unsigned long long result) and
+  ass6.cpp (unsigned char elements , result mod 256) over a sweep of
+  matrix sizes , thread counts and kernels.
+- Each configuration is one process started with --repeat=warmup+trials;
+  the first `warmup` runs are dropped (they also pay for page faults).
+- Reports per configuration:
+    median / min / mean / stddev of the multiply time
+    GOPS       -> 2*N^3 integer operations per second (multiply + add)
+    bandwidth  -> compulsory traffic (read A and B once , write C once)
+                  divided by the median time , with the element sizes the
+                  run reports: narrow's chosen input/output types , and
+                  1 bit per element of A and B for the bit-packed kernels
+    efficiency -> T(1 thread) / (threads * T(threads)) for the same
+                  kernel and N , empty when 1 thread is not in the sweep
+- Writes a table to stdout and optionally CSV and JSON files.
+
+Kernels and the program (element type) that runs them:
+    u32 (./matrix_mult) : naive , blocked , strassen , narrow
+    u8  (./ass6)        : scalar , sse42 , avx2 , avx512 , bitpacked , auto
+A kernel can be prefixed with its type to pick the program explicitly,
+e.g. u32:bitpacked runs ass3.cpp's bit-packed kernel (both need --mod=2).
+
+Command Line Arguments (all optional):
+--sizes=N1,N2,...        (default 256,512,1024)
+--threads=T1,T2,...      (default 1,2,4)
+--kernels=K1,K2,...      (default naive,blocked,scalar,auto)
+--warmup=W               (default 1)
+--trials=R               (default 5)
+--mod=M                  mod value passed to both programs (default 100)
+--seed=S                 seed passed to both programs (default 1)
+--csv=FILE               write results as CSV
+--json=FILE              write results as JSON
+--u32-bin=PATH           ass3.cpp binary (default ./matrix_mult)
+--u8-bin=PATH            ass6.cpp binary (default ./ass6)
+
+Example usage:
+./matrix_bench --sizes=1024,2048 --threads=1,2,4,8 --kernels=blocked,auto --csv=mm.csv --json=mm.json
+
+Compile:
+g++ -O2 matrix_bench.cpp -o matrix_bench
+*/
+
+
+
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<vector>
+#include<string>
+#include<cstring>     // for strncmp()
+#include<cstdio>      // for popen()
+#include<cstdlib>     // for atoi()
+#include<cmath>       // for sqrt() , isfinite()
+#include<algorithm>   // for sort()
+#include<iomanip>
+
+using namespace std;
+
+struct BenchResult{
+    string type;          // u32 or u8
+    string kernel;
+    int N;
+    int threads;
+    vector<double> times; // seconds , warmups already dropped
+    bool ok;
+
+    double in_bytes , out_bytes;   // per element of A/B and of C
+    bool bitpacked;                // A and B packed 64 elements per word
+
+    double median , min , mean , stddev;
+    double gops , bandwidth_gbs , efficiency;
+};
+
+vector<string> split(const string& list){
+        vector<string> items;
+        stringstream ss(list);
+        string item;
+        while(getline(ss , item , ',')){
+            if(!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+// u32 kernels belong to ass3.cpp , everything else to ass6.cpp
+string kernel_type(const string& kernel){
+        if(kernel == "naive" || kernel == "blocked" || kernel == "strassen" || kernel == "narrow") return "u32";
+        return "u8";
+    }
+
+// Bytes of A + B + C for one multiplication
+double compulsory_bytes(const BenchResult& r){
+        double n2 = (double)r.N*r.N;
+        double ab = r.bitpacked ? 2.0*r.N*((r.N + 63)/64)*8 : 2*n2*r.in_bytes;
+        return ab + n2*r.out_bytes;
+    }
+
+// Runs one configuration and collects the times of every repeat
+// ass3.cpp prints "Run k: X seconds" , ass6.cpp prints "Run k (ms): X" ,
+// with a single repeat only the final time line is printed.
+// Element sizes start at the program's defaults (u32/u64 , u8/u8) and are
+// replaced by what the run prints: ass3.cpp's "Narrow Types:" line , its
+// "Popcount Kernel:" line (bit-packed) , or ass6.cpp's "Kernel: bitpacked"
+// (also what auto picks for mod = 2).
+bool run_config(const string& cmd , BenchResult& r , vector<double>& times){
+        const string& type = r.type;
+        r.in_bytes = (type == "u32") ? 4 : 1;
+        r.out_bytes = (type == "u32") ? 8 : 1;
+        r.bitpacked = false;
+
+        FILE* pipe = popen(cmd.c_str() , "r");
+        if(!pipe){
+            perror("popen");
+            return false;
+        }
+
+        char line[512];
+        double final_time = -1;
+
+        while(fgets(line , sizeof(line) , pipe)){
+            double t;
+            int run , in_bits , acc_bits , out_bits;
+            if(type == "u32"){
+                if(sscanf(line , "Run %d: %lf" , &run , &t) == 2) times.push_back(t);
+                else if(sscanf(line , "Time for Parallel Matrix Multiplication: %lf" , &t) == 1) final_time = t;
+                else if(sscanf(line , "Narrow Types: in = u%d , acc = u%d , out = u%d" , &in_bits , &acc_bits , &out_bits) == 3){
+                    r.in_bytes = in_bits/8;
+                    r.out_bytes = out_bits/8;
+                }
+                else if(strncmp(line , "Popcount Kernel:" , 16) == 0) r.bitpacked = true;
+            }
+            else{
+                if(sscanf(line , "Run %d (ms): %lf" , &run , &t) == 2) times.push_back(t/1000.0);
+                else if(sscanf(line , "Time (ms): %lf" , &t) == 1) final_time = t/1000.0;
+                else if(strncmp(line , "Kernel: bitpacked" , 17) == 0) r.bitpacked = true;
+            }
+        }
+
+        int status = pclose(pipe);
+
+        if(times.empty() && final_time >= 0){
+            times.push_back(final_time);
+        }
+        return status == 0 && !times.empty();
+    }
+
+void compute_stats(BenchResult& r){
+        vector<double> sorted = r.times;
+        sort(sorted.begin() , sorted.end());
+
+        size_t n = sorted.size();
+        r.median = (n % 2) ? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2])/2;
+        r.min = sorted[0];
+
+        double sum = 0;
+        for(double t : sorted) sum += t;
+        r.mean = sum/n;
+
+        double var = 0;
+        for(double t : sorted) var += (t - r.mean)*(t - r.mean);
+        r.stddev = (n > 1) ? sqrt(var/(n - 1)) : 0;
+
+        // A median of 0 (timer resolution) or inf/nan parsed from the output
+        // has no meaningful rate , -1 marks it like a missing efficiency
+        bool timed = isfinite(r.median) && r.median > 0;
+        r.gops = timed ? 2.0*r.N*r.N*(double)r.N/r.median/1e9 : -1;
+        r.bandwidth_gbs = timed ? compulsory_bytes(r)/r.median/1e9 : -1;
+        r.efficiency = -1;
+    }
+
+// Writes v , or missing ("" in CSV , null in JSON) when it is negative or
+// not finite , so inf/nan never reach the files
+void put_value(ostream& out , double v , const char* missing){
+        if(isfinite(v) && v >= 0) out << v;
+        else out << missing;
+    }
+
+void write_csv(const string& path , const vector<BenchResult>& results){
+        ofstream out(path);
+        out << "type,kernel,N,threads,trials,median_s,min_s,mean_s,stddev_s,gops,bandwidth_gbs,efficiency,ok\n";
+        for(auto &r : results){
+            out << r.type << "," << r.kernel << "," << r.N << "," << r.threads << "," << r.times.size();
+            if(r.ok){
+                for(double v : {r.median , r.min , r.mean , r.stddev , r.gops , r.bandwidth_gbs , r.efficiency}){
+                    out << ",";
+                    put_value(out , v , "");
+                }
+            }
+            else{
+                out << ",,,,,,,";
+            }
+            out << "," << (r.ok ? 1 : 0) << "\n";
+        }
+    }
+
+void write_json(const string& path , const vector<BenchResult>& results){
+        ofstream out(path);
+        out << "[\n";
+        for(size_t i=0; i<results.size() ; i++){
+            auto &r = results[i];
+            out << "  {\"type\": \"" << r.type << "\", \"kernel\": \"" << r.kernel << "\", \"N\": " << r.N
+                << ", \"threads\": " << r.threads << ", \"ok\": " << (r.ok ? "true" : "false");
+            if(r.ok){
+                out << ", \"times_s\": [";
+                for(size_t t=0; t<r.times.size() ; t++){
+                    out << (t ? ", " : "");
+                    put_value(out , r.times[t] , "null");
+                }
+                out << "], \"median_s\": ";      put_value(out , r.median , "null");
+                out << ", \"min_s\": ";          put_value(out , r.min , "null");
+                out << ", \"mean_s\": ";         put_value(out , r.mean , "null");
+                out << ", \"stddev_s\": ";       put_value(out , r.stddev , "null");
+                out << ", \"gops\": ";           put_value(out , r.gops , "null");
+                out << ", \"bandwidth_gbs\": ";  put_value(out , r.bandwidth_gbs , "null");
+                out << ", \"efficiency\": ";     put_value(out , r.efficiency , "null");
+            }
+            out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+
+
+int main(int argc , char* argv[]){
+        vector<string> sizes = split("256,512,1024");
+        vector<string> thread_counts = split("1,2,4");
+        vector<string> kernels = split("naive,blocked,scalar,auto");
+        int warmup = 1;
+        int trials = 5;
+        int mod_value = 100;
+        string seed = "1";
+        string csv_path , json_path;
+        string u32_bin = "./matrix_mult" , u8_bin = "./ass6";
+
+        for(int a=1; a<argc ; a++){
+            if(strncmp(argv[a] , "--sizes=" , 8) == 0) sizes = split(argv[a] + 8);
+            else if(strncmp(argv[a] , "--threads=" , 10) == 0) thread_counts = split(argv[a] + 10);
+            else if(strncmp(argv[a] , "--kernels=" , 10) == 0) kernels = split(argv[a] + 10);
+            else if(strncmp(argv[a] , "--warmup=" , 9) == 0) warmup = max(0 , atoi(argv[a] + 9));
+            else if(strncmp(argv[a] , "--trials=" , 9) == 0) trials = max(1 , atoi(argv[a] + 9));
+            else if(strncmp(argv[a] , "--mod=" , 6) == 0) mod_value = atoi(argv[a] + 6);
+            else if(strncmp(argv[a] , "--seed=" , 7) == 0) seed = argv[a] + 7;
+            else if(strncmp(argv[a] , "--csv=" , 6) == 0) csv_path = argv[a] + 6;
+            else if(strncmp(argv[a] , "--json=" , 7) == 0) json_path = argv[a] + 7;
+            else if(strncmp(argv[a] , "--u32-bin=" , 10) == 0) u32_bin = argv[a] + 10;
+            else if(strncmp(argv[a] , "--u8-bin=" , 9) == 0) u8_bin = argv[a] + 9;
+            else{
+                cerr << "Unknown option: " << argv[a] << endl;
+                return 1;
+            }
+        }
+
+        vector<BenchResult> results;
+
+        for(auto &entry : kernels){
+            string kernel = entry , type;
+            size_t colon = entry.find(':');
+            if(colon != string::npos){
+                type = entry.substr(0 , colon);
+                kernel = entry.substr(colon + 1);
+            }
+            else{
+                type = kernel_type(kernel);
+            }
+
+            for(auto &size : sizes){
+                for(auto &threads : thread_counts){
+                    BenchResult r;
+                    r.type = type;
+                    r.kernel = kernel;
+                    r.N = atoi(size.c_str());
+                    r.threads = atoi(threads.c_str());
+
+                    stringstream cmd;
+                    cmd << (type == "u32" ? u32_bin : u8_bin) << " " << r.N << " " << r.threads << " "
+                        << mod_value << " 0 --kernel=" << kernel << " --repeat=" << warmup + trials
+                        << " --seed=" << seed;
+                    if(type == "u32") cmd << " --no-verify";
+                    cmd << " 2>&1";
+
+                    cerr << "Running: " << cmd.str() << endl;
+
+                    vector<double> times;
+                    r.ok = run_config(cmd.str() , r , times);
+
+                    // Drop the warmups , a single-run fallback has nothing to drop
+                    if(r.ok && (int)times.size() > warmup){
+                        times.erase(times.begin() , times.begin() + warmup);
+                    }
+                    r.times = times;
+
+                    if(r.ok){
+                        compute_stats(r);
+                    }
+                    else{
+                        cerr << "  failed" << endl;
+                    }
+                    results.push_back(r);
+                }
+            }
+        }
+
+        // Scaling efficiency against the 1-thread run of the same type , kernel and N
+        for(auto &r : results){
+            if(!r.ok) continue;
+            for(auto &base : results){
+                if(base.ok && base.threads == 1 && base.type == r.type && base.kernel == r.kernel && base.N == r.N){
+                    double eff = base.median/(r.threads*r.median);
+                    if(isfinite(eff)) r.efficiency = eff;
+                }
+            }
+        }
+
+        cout << left << setw(5) << "type" << setw(10) << "kernel" << right << setw(7) << "N" << setw(8) << "threads"
+             << setw(12) << "median(s)" << setw(12) << "min(s)" << setw(12) << "stddev(s)"
+             << setw(10) << "GOPS" << setw(10) << "GB/s" << setw(8) << "eff" << endl;
+
+        for(auto &r : results){
+            cout << left << setw(5) << r.type << setw(10) << r.kernel << right << setw(7) << r.N << setw(8) << r.threads;
+            if(!r.ok){
+                cout << "  FAILED" << endl;
+                continue;
+            }
+            cout << fixed << setprecision(4) << setw(12) << r.median << setw(12) << r.min << setw(12) << r.stddev
+                 << setprecision(2);
+            for(double v : {r.gops , r.bandwidth_gbs}){
+                if(v >= 0) cout << setw(10) << v;
+                else cout << setw(10) << "-";
+            }
+            if(r.efficiency >= 0) cout << setw(8) << r.efficiency;
+            cout << defaultfloat << endl;
+        }
+
+        if(!csv_path.empty()) write_csv(csv_path , results);
+        if(!json_path.empty()) write_json(json_path , results);
+
+        return 0;
+    }
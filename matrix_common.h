@@ -0,0 +1,340 @@
+/*
+Helpers shared by ass3.cpp (unsigned int / unsigned long long matrices) and
+ass6.cpp (unsigned char matrices):
+
+- thread pinning for --pin
+- FirstTouchAllocator , so matrix pages are first touched by the threads
+  that initialize them
+- random_element , the counter-based generator for A and B (both programs
+  fill the same A and B for a given seed and mod) , and random_bit_row ,
+  which generates the bit-packed rows of the mod = 2 kernels directly
+- the AND + popcount kernels of the bit-packed (mod = 2) multiplication
+- Tile and the persistent WorkStealingPool behind --sched=steal / --steal
+
+Header only , include it next to the program:
+g++ -O3 -march=native -pthread ass3.cpp -o matrix_mult
+*/
+
+#ifndef MATRIX_COMMON_H
+#define MATRIX_COMMON_H
+
+#include<iostream>
+#include<vector>
+#include<thread>
+#include<string>
+#include<cstdio>      // for perror()
+#include<cstring>     // for strerror()
+#include<deque>
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
+#include<memory>      // for allocator
+#include<immintrin.h> // AVX-512 popcount for the bit-packed kernel
+#include<pthread.h>   // pthread_setaffinity_np()
+#include<sched.h>     // cpu_set_t
+
+typedef unsigned long long u64;
+
+
+
+// Set by --pin , every worker thread calls pin_thread() with its index.
+// Thread t goes to the t-th CPU the process may run on (taskset / cgroup
+// cpuset) , read by main() before any thread is pinned.
+inline bool pin_threads = false;
+inline std::vector<int> pin_cpus;
+
+inline std::vector<int> allowed_cpus(){
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(sched_getaffinity(0 , sizeof(set) , &set) != 0){
+            perror("sched_getaffinity");
+            return cpus;
+        }
+        for(int c=0; c<CPU_SETSIZE ; c++){
+            if(CPU_ISSET(c , &set)) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+inline void pin_thread(int t){
+        if(!pin_threads || pin_cpus.empty()) return;
+
+        int cpu = pin_cpus[t % pin_cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu , &set);
+        int err = pthread_setaffinity_np(pthread_self() , sizeof(set) , &set);
+        if(err != 0){
+            std::cerr << "Warning: could not pin thread " << t << " to CPU " << cpu << ": " << strerror(err) << std::endl;
+        }
+    }
+
+
+
+// Allocator that leaves elements uninitialized, so the pages of a matrix are
+// first touched by the threads that initialize it instead of by main()
+
+template<typename T>
+struct FirstTouchAllocator : std::allocator<T>{
+    template<typename U> struct rebind{ typedef FirstTouchAllocator<U> other; };
+
+    FirstTouchAllocator() = default;
+    template<typename U> FirstTouchAllocator(const FirstTouchAllocator<U>&){}
+
+    template<typename U> void construct(U* p){ ::new((void*)p) U; }
+    template<typename U , typename... Args> void construct(U* p , Args&&... args){
+        ::new((void*)p) U(std::forward<Args>(args)...);
+    }
+};
+
+
+
+// Counter-based random numbers: SplitMix64 of (seed , stream , idx) mapped
+// to [0 , mod) with a multiply-shift. stream 0 is A , stream 1 is B.
+
+inline unsigned int random_element(u64 seed , u64 stream , u64 idx , unsigned int mod){
+        u64 z = (seed*2 + stream)*0xD1B54A32D192ED03ULL + idx*0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+        z = z ^ (z >> 31);
+        return (unsigned int)(((z >> 32)*mod) >> 32);
+    }
+
+// Row r of a bit-packed mod 2 matrix straight from the generator: bit k is
+// element (r , k) of stream , or (k , r) with transpose (column r , for
+// B^T). Each word is built in a register , the unpacked matrix never exists.
+inline void random_bit_row(u64* row , u64 seed , u64 stream , u64 N , u64 r , bool transpose){
+        u64 W = (N + 63)/64;
+        for(u64 w=0; w<W ; w++){
+            u64 word = 0;
+            u64 kend = (64*w + 64 < N) ? 64*w + 64 : N;
+            for(u64 k=64*w ; k<kend ; k++){
+                u64 idx = transpose ? k*N + r : r*N + k;
+                word |= (u64)random_element(seed , stream , idx , 2) << (k % 64);
+            }
+            row[w] = word;
+        }
+    }
+
+
+
+// A[i][k] = B[k][j] = 1. Row i of A and column j of B (row j of B^T) are
+// packed into W = ceil(N/64) words each and
+//     C[i][j] = sum over w of popcount(Ap[i][w] & Btp[j][w])
+
+typedef u64 (*and_popcount_fn)(const u64* a , const u64* b , int words);
+
+inline u64 and_popcount_scalar(const u64* a , const u64* b , int words){
+        u64 sum = 0;
+        for(int w=0; w<words ; w++){
+            sum += __builtin_popcountll(a[w] & b[w]);
+        }
+        return sum;
+    }
+
+__attribute__((target("popcnt")))
+inline u64 and_popcount_popcnt(const u64* a , const u64* b , int words){
+        u64 sum = 0;
+        for(int w=0; w<words ; w++){
+            sum += __builtin_popcountll(a[w] & b[w]);
+        }
+        return sum;
+    }
+
+// 8 words per step with VPOPCNTQ , the tail goes through popcnt
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+inline u64 and_popcount_avx512(const u64* a , const u64* b , int words){
+        __m512i acc = _mm512_setzero_si512();
+        int w = 0;
+        for(; w + 8 <= words ; w+=8){
+            __m512i x = _mm512_and_si512(_mm512_loadu_si512(a + w) , _mm512_loadu_si512(b + w));
+            acc = _mm512_add_epi64(acc , _mm512_popcnt_epi64(x));
+        }
+        u64 lanes[8];
+        _mm512_storeu_si512(lanes , acc);
+
+        u64 sum = 0;
+        for(int l=0; l<8 ; l++){
+            sum += lanes[l];
+        }
+        for(; w<words ; w++){
+            sum += __builtin_popcountll(a[w] & b[w]);
+        }
+        return sum;
+    }
+
+inline and_popcount_fn and_popcount = and_popcount_scalar;
+
+// Picks the popcount kernel from CPUID , returns its name
+inline std::string select_popcount(){
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512vpopcntdq")){
+            and_popcount = and_popcount_avx512;
+            return "avx512-vpopcntdq";
+        }
+        if(__builtin_cpu_supports("popcnt")){
+            and_popcount = and_popcount_popcnt;
+            return "popcnt";
+        }
+        and_popcount = and_popcount_scalar;
+        return "scalar";
+    }
+
+
+
+// Rectangle of C handed out as one task: rows [r0,r1) , columns [c0,c1)
+
+struct Tile{
+    int r0 , r1 , c0 , c1;
+};
+
+
+
+// Persistent work-stealing pool
+// - Workers are started once and sleep between jobs, so repeated
+//   multiplications do not pay thread creation again.
+// - Each worker owns a deque of tiles: it pops from the back of its own
+//   deque and, once empty, steals from the front of the other deques.
+// - executed/steals are kept per worker across all jobs.
+
+class WorkStealingPool{
+    public:
+
+        explicit WorkStealingPool(int num_workers) : queues(num_workers) , stats(num_workers){
+            for(int w=0; w<num_workers ; w++){
+                workers.emplace_back(&WorkStealingPool::worker_loop , this , w);
+            }
+        }
+
+        ~WorkStealingPool(){
+            {
+                std::lock_guard<std::mutex> lock(job_mtx);
+                stop = true;
+            }
+            job_cv.notify_all();
+
+            for(auto &th : workers){
+                th.join();
+            }
+        }
+
+        // Runs task on every tile and returns once all of them are done
+        void run(const std::vector<Tile>& tiles , std::function<void(const Tile&)> task){
+            int W = queues.size();
+
+            // Contiguous runs of tiles per worker keep neighbouring tiles together
+            for(int w=0; w<W ; w++){
+                size_t first = tiles.size()*w/W;
+                size_t last = tiles.size()*(w+1)/W;
+
+                std::lock_guard<std::mutex> lock(queues[w].mtx);
+                queues[w].tiles.assign(tiles.begin()+first , tiles.begin()+last);
+            }
+
+            std::unique_lock<std::mutex> lock(job_mtx);
+            current_task = std::move(task);
+            remaining = tiles.size();
+            active = W;
+            generation++;
+            job_cv.notify_all();
+
+            done_cv.wait(lock , [this]{ return active == 0; });
+        }
+
+        void print_stats() const{
+            std::cout << "Work-stealing pool statistics:" << std::endl;
+            for(size_t w=0; w<stats.size() ; w++){
+                std::cout << "  Worker " << w << ": tiles = " << stats[w].executed
+                          << " , steals = " << stats[w].steals << std::endl;
+            }
+        }
+
+    private:
+
+        struct WorkerQueue{
+            std::mutex mtx;
+            std::deque<Tile> tiles;
+        };
+
+        struct WorkerStats{
+            long long executed = 0;
+            long long steals = 0;
+        };
+
+        std::vector<WorkerQueue> queues;
+        std::vector<WorkerStats> stats;
+        std::vector<std::thread> workers;
+
+        std::mutex job_mtx;
+        std::condition_variable job_cv , done_cv;
+        std::function<void(const Tile&)> current_task;
+        std::atomic<long long> remaining{0};
+        int active = 0;
+        long long generation = 0;
+        bool stop = false;
+
+        bool pop_local(int w , Tile& t){
+            std::lock_guard<std::mutex> lock(queues[w].mtx);
+            if(queues[w].tiles.empty()) return false;
+            t = queues[w].tiles.back();
+            queues[w].tiles.pop_back();
+            return true;
+        }
+
+        bool steal(int w , Tile& t){
+            int W = queues.size();
+            for(int d=1; d<W ; d++){
+                int victim = (w + d) % W;
+                std::lock_guard<std::mutex> lock(queues[victim].mtx);
+                if(!queues[victim].tiles.empty()){
+                    t = queues[victim].tiles.front();
+                    queues[victim].tiles.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void worker_loop(int w){
+            long long seen = 0;
+            pin_thread(w);
+
+            while(true){
+                std::function<void(const Tile&)> task;
+                {
+                    std::unique_lock<std::mutex> lock(job_mtx);
+                    job_cv.wait(lock , [&]{ return stop || generation != seen; });
+                    if(stop) return;
+                    seen = generation;
+                    task = current_task;
+                }
+
+                // No tiles are added during a job, so once the local deque and
+                // every victim are empty this worker has nothing left to do
+                Tile t;
+                while(remaining.load() > 0){
+                    if(pop_local(w , t)){
+                        stats[w].executed++;
+                    }
+                    else if(steal(w , t)){
+                        stats[w].executed++;
+                        stats[w].steals++;
+                    }
+                    else{
+                        break;
+                    }
+                    task(t);
+                    remaining--;
+                }
+
+                std::lock_guard<std::mutex> lock(job_mtx);
+                if(--active == 0){
+                    done_cv.notify_all();
+                }
+            }
+        }
+};
+
+#endif